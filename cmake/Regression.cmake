@@ -0,0 +1,80 @@
+# End-to-end throughput regression test, run by ctest with cmake -P.
+#
+# Simulates a data set with appspam_simulate, places it with appspam and compares
+# queries per second, peak RSS and the placement checksum with a stored baseline.
+# The test fails if the checksum changes or throughput drops by more than TOLERANCE.
+# If no baseline exists (or UPDATE is set) the results are stored as new baseline.
+#
+# Variables: APPSPAM, SIMULATE, NAME, LEAVES, LENGTH, QUERIES, THREADS,
+#            WORK_DIR, BASELINE_DIR, TOLERANCE, UPDATE
+cmake_minimum_required(VERSION 3.19)
+
+set(dir "${WORK_DIR}/${NAME}")
+set(prefix "${dir}/sim")
+file(MAKE_DIRECTORY "${dir}")
+
+execute_process(COMMAND "${SIMULATE}" --leaves ${LEAVES} --length ${LENGTH} --queries ${QUERIES} --seed 1 -o "${prefix}"
+	RESULT_VARIABLE result OUTPUT_QUIET)
+if (NOT result EQUAL 0)
+	message(FATAL_ERROR "appspam_simulate failed")
+endif()
+
+execute_process(COMMAND "${APPSPAM}" -s "${prefix}_references.fasta" -t "${prefix}_tree.nwk" -q "${prefix}_queries.fasta"
+		-o "${dir}/placements.jplace" --threads ${THREADS} -b 1000 --write-report
+	RESULT_VARIABLE result OUTPUT_QUIET)
+if (NOT result EQUAL 0)
+	message(FATAL_ERROR "appspam failed")
+endif()
+
+execute_process(COMMAND "${SIMULATE}" --evaluate "${prefix}" "${dir}/placements.jplace"
+	RESULT_VARIABLE result OUTPUT_VARIABLE evaluation)
+if (NOT result EQUAL 0)
+	message(FATAL_ERROR "Evaluation of placements failed")
+endif()
+string(REGEX MATCH "placement_checksum\t([0-9a-f]+)" _ "${evaluation}")
+set(checksum "${CMAKE_MATCH_1}")
+string(REGEX MATCH "correct_edge\t([0-9.e-]+)" _ "${evaluation}")
+set(correct "${CMAKE_MATCH_1}")
+
+file(READ "${dir}/run_report.json" report)
+string(JSON wall GET "${report}" wall_seconds)
+string(JSON rss GET "${report}" peak_rss_kb)
+
+# Queries per second in integer arithmetic from wall time in milliseconds
+string(REGEX MATCH "^([0-9]+)(\\.([0-9]*))?" _ "${wall}")
+set(wall_s "${CMAKE_MATCH_1}")
+string(SUBSTRING "${CMAKE_MATCH_3}000" 0 3 wall_frac)
+string(REGEX REPLACE "^0+([0-9])" "\\1" wall_frac "${wall_frac}")
+math(EXPR wall_ms "${wall_s} * 1000 + ${wall_frac}")
+if (wall_ms LESS 1)
+	set(wall_ms 1)
+endif()
+math(EXPR qps_int "${QUERIES} * 1000 / ${wall_ms}")
+
+message(STATUS "${NAME}: ${qps_int} queries/s, peak RSS ${rss} kB, correct edge ${correct}, checksum ${checksum}")
+
+set(baseline "${BASELINE_DIR}/${NAME}.cmake")
+if (UPDATE OR NOT EXISTS "${baseline}")
+	file(MAKE_DIRECTORY "${BASELINE_DIR}")
+	file(WRITE "${baseline}"
+		"set(baseline_qps ${qps_int})\nset(baseline_rss ${rss})\nset(baseline_checksum ${checksum})\nset(baseline_correct ${correct})\n")
+	message(STATUS "${NAME}: stored new baseline ${baseline}")
+	return()
+endif()
+
+include("${baseline}")
+if (NOT checksum STREQUAL baseline_checksum)
+	message(FATAL_ERROR "${NAME}: placements changed (checksum ${checksum}, baseline ${baseline_checksum}, "
+		"correct edge ${correct}, baseline ${baseline_correct})")
+endif()
+
+math(EXPR min_qps "${baseline_qps} * (100 - ${TOLERANCE}) / 100")
+if (qps_int LESS min_qps)
+	message(FATAL_ERROR "${NAME}: throughput dropped to ${qps_int} queries/s (baseline ${baseline_qps}, "
+		"tolerance ${TOLERANCE}%)")
+endif()
+
+math(EXPR max_rss "${baseline_rss} * (100 + ${TOLERANCE}) / 100")
+if (rss GREATER max_rss)
+	message(WARNING "${NAME}: peak RSS grew to ${rss} kB (baseline ${baseline_rss} kB)")
+endif()
@@ -19,11 +19,47 @@
 #include <vector>
 #include "Word.h"
 #include "BucketManager.h"
+#include "ScoreHistogram.h"
+#include "ExternalBuckets.h"
+#include "Scoring.h"
+#include "GenomeManager.h"
+
+// Part of the join of a bucket: read word groups [firstGroup, lastGroup) of a minimizer
+struct JoinUnit {
+	minimizer_t minimizer;
+	uint firstGroup;
+	uint lastGroup;
+
+	// Number of word pairs that are compared
+	uint64_t candidatePairs;
+};
 
 class Algorithms {		
 	public:
 		// Complete checks the quadratic number of matches between corresponding buckets
-		static bool fswm_complete(BucketManager &genomeBucketManager, BucketManager &readBucketManager, Scoring &fswm_distances);
+		// Scores of all spaced word matches are added to histogram if given
+		static bool fswm_complete(BucketManager &genomeBucketManager, BucketManager &readBucketManager, Scoring &fswm_distances,
+				const Parameters &params, ScoreHistogram *histogram = nullptr);
+
+		// Same as above, but buckets are split into units of about equal candidate pairs that are joined as
+		// OpenMP tasks. Must be called inside a parallel region; gives exactly the same scoring as fswm_complete.
+		// Every task joins with the genome buckets of its thread's NUMA node (see GenomeManager::get_BucketManager).
+		static bool fswm_complete_tasks(GenomeManager &genomeManager, BucketManager &readBucketManager, Scoring &fswm_distances,
+				const Parameters &params, ScoreHistogram *histogram = nullptr);
+
+		// Split joins of all buckets into about the given number of units, in order of minimizer and word groups.
+		// Units without candidate pairs are left out.
+		static std::vector<JoinUnit> plan_join_units(BucketManager &genomeBucketManager, BucketManager &readBucketManager,
+				uint32_t units, const Parameters &params);
+
+		// Join the word groups of one unit.
+		static void join_unit(BucketManager &genomeBucketManager, BucketManager &readBucketManager, const JoinUnit &unit,
+				PartialScoring &partialScoring, ScoreHistogram *histogram, uint64_t &candidatePairs, uint64_t &count,
+				const Parameters &params);
+
+		// Same as fswm_complete, but genome buckets are streamed from disk one block at a time
+		static bool fswm_complete(ExternalBuckets &genomeBuckets, BucketManager &readBucketManager, Scoring &fswm_distances,
+				const Parameters &params, ScoreHistogram *histogram = nullptr);
 };
 
 #endif
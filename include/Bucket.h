@@ -31,15 +31,30 @@ class Bucket {
 		// number of elements in this group
 		std::vector<std::pair<uint, uint>> wordGroups;
 
+		// Open addressing table (linear probing) from matches of a word group to the index
+		// of the group plus one, 0 marks empty slots. Built for reference buckets only.
+		std::vector<uint32_t> groupIndex;
+		uint64_t groupIndexMask;
+
+		static uint64_t hash_matches(word_t matches);
+
 	public:
 		// Constructors
 		Bucket(minimizer_t minimizer);
 
 		// Functions
 		bool add_word(Word &newWord);
+		bool set_words(std::vector<Word> &newWords);
 		bool sort_words();
+		static bool word_order(const Word &a, const Word &b);
 		bool words_sorted() const;
 		bool create_wordGroups();
+		bool create_groupIndex();
+		bool has_groupIndex() const;
+
+		// Index of the word group with the given matches, or -1 if there is none.
+		int64_t find_wordGroup(word_t matches) const;
+		void prefetch_wordGroup(word_t matches) const;
 
 		// Get & Set
 		std::vector<Word>& get_words();
@@ -67,8 +82,31 @@ inline bool Bucket::add_word(Word &newWord) {
 	return true;
 }
 
+// Replace all words of the bucket, newWords is left with the previous words.
+inline bool Bucket::set_words(std::vector<Word> &newWords) {
+	words.swap(newWords);
+	bucketSize = words.size();
+	wordGroups.clear();
+	groupIndex.clear();
+	return true;
+}
+
+// Words with equal matches are ordered by sequence and position, so the order of words
+// (and of matches found in them) does not depend on the order in which words were added.
+inline bool Bucket::word_order(const Word &a, const Word &b) {
+	if (a.matches != b.matches) {
+		return a.matches < b.matches;
+	}
+	if (a.seqID != b.seqID) {
+		return a.seqID < b.seqID;
+	}
+	return a.seqPos < b.seqPos;
+}
+
 inline bool Bucket::sort_words() {
-	std::sort(words.begin(), words.end());
+	if (!std::is_sorted(words.begin(), words.end(), word_order)) {
+		std::sort(words.begin(), words.end(), word_order);
+	}
 	return true;
 }
 
@@ -76,6 +114,28 @@ inline bool Bucket::words_sorted() const {
 	return std::is_sorted(words.begin(), words.end());
 }
 
+inline uint64_t Bucket::hash_matches(word_t matches) {
+	return (matches * 0x9E3779B97F4A7C15ULL) >> 32;
+}
+
+inline bool Bucket::has_groupIndex() const {
+	return !groupIndex.empty();
+}
+
+inline int64_t Bucket::find_wordGroup(word_t matches) const {
+	for (uint64_t slot = hash_matches(matches) & groupIndexMask; groupIndex[slot] != 0; slot = (slot + 1) & groupIndexMask) {
+		if (words[wordGroups[groupIndex[slot] - 1].first].matches == matches) {
+			return groupIndex[slot] - 1;
+		}
+	}
+	return -1;
+}
+
+// Load the first slot of a lookup of find_wordGroup into the cache.
+inline void Bucket::prefetch_wordGroup(word_t matches) const {
+	__builtin_prefetch(&groupIndex[hash_matches(matches) & groupIndexMask]);
+}
+
 inline std::vector<Word>& Bucket::get_words() {
 	return words;
 }
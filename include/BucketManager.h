@@ -34,8 +34,10 @@ class BucketManager {
 
 		// Functions
 		bool insert_word(Word &word);
+		bool set_words(minimizer_t minimizer, std::vector<Word> &words);
 		bool sort_words_in_buckets();
 		bool create_wordGroups();
+		bool create_groupIndexes();
 
 		// Debug functions
 		bool print_bucket_information() const;
@@ -43,7 +45,9 @@ class BucketManager {
 		// Get & Set
 		int get_bucketCount() const;
 		std::vector<minimizer_t> get_minimizers();
-		Bucket get_bucket(minimizer_t minimizer);
+		Bucket& get_bucket(minimizer_t minimizer);
+		uint64_t get_wordCount();
+		std::vector<Word>& get_words(minimizer_t minimizer);
 };
 
 inline bool BucketManager::insert_word(Word &word) {
@@ -51,6 +55,10 @@ inline bool BucketManager::insert_word(Word &word) {
 	return true;
 }
 
+inline bool BucketManager::set_words(minimizer_t minimizer, std::vector<Word> &words) {
+	return minimizersToBuckets.find(minimizer)->second.set_words(words);
+}
+
 inline int BucketManager::get_bucketCount() const {
 	return bucketCount;
 }
@@ -59,8 +67,20 @@ inline std::vector<minimizer_t> BucketManager::get_minimizers() {
 	return minimizers;
 }
 
-inline Bucket BucketManager::get_bucket(minimizer_t minimizer) {
+inline Bucket& BucketManager::get_bucket(minimizer_t minimizer) {
 	return minimizersToBuckets.find(minimizer)->second;
 }
 
+inline std::vector<Word>& BucketManager::get_words(minimizer_t minimizer) {
+	return minimizersToBuckets.find(minimizer)->second.get_words();
+}
+
+inline uint64_t BucketManager::get_wordCount() {
+	uint64_t wordCount = 0;
+	for (auto const &minimizerToBucket : minimizersToBuckets) {
+		wordCount += minimizerToBucket.second.get_bucketSize();
+	}
+	return wordCount;
+}
+
 #endif
@@ -0,0 +1,81 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Reference buckets on disk for runs with a memory limit. Words of the references
+ * are collected in a BucketManager and spilled as sorted runs whenever it gets too
+ * large. finish merges the runs of every bucket into one file sorted by
+ * Bucket::word_order, which is then read in blocks by Algorithms::fswm_complete.
+ *
+ * All files are created in a new temporary folder that is removed with the object,
+ * or when the program exits or is stopped with SIGINT or SIGTERM before.
+ *
+ * Example:
+ * 	ExternalBuckets externalBuckets(tmpfoldername, blockWords);
+ * 	externalBuckets.spill(bucketManagerGenomes);		// as often as needed
+ * 	externalBuckets.finish();
+ * 	Algorithms::fswm_complete(externalBuckets, bucketManagerReads, fswm_distances);
+ */
+#ifndef FSWM_EXTERNALBUCKETS_H_
+#define FSWM_EXTERNALBUCKETS_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include "BucketManager.h"
+
+class ExternalBuckets {
+	private:
+		std::string foldername;
+		uint64_t blockWords;
+		bool verbose;
+		uint32_t runCount;
+
+		// Files of sorted runs and number of words per minimizer
+		std::unordered_map<minimizer_t, std::vector<std::string>> runfnames;
+		std::unordered_map<minimizer_t, uint64_t> bucketSizes;
+
+		bool merge_runs(minimizer_t minimizer);
+		static bool read_words(std::ifstream &wordStream, std::vector<Word> &words, uint64_t count);
+
+	public:
+		// Create temporary folder in tmpfoldername, words are read in blocks of blockWords words.
+		ExternalBuckets(std::string tmpfoldername, uint64_t blockWords, bool verbose);
+		~ExternalBuckets();
+		ExternalBuckets(const ExternalBuckets&) = delete;
+		ExternalBuckets& operator=(const ExternalBuckets&) = delete;
+
+		// Sort words of all buckets, write them as one run per bucket and empty the buckets.
+		void spill(BucketManager &bucketManager);
+
+		// Merge runs of every bucket into a single sorted bucket file.
+		void finish();
+
+		// Append the next block of words of a bucket file to block, false at the end of the file.
+		bool read_block(std::ifstream &bucketStream, std::vector<Word> &block) const;
+
+		std::string get_bucket_filename(minimizer_t minimizer) const;
+		uint64_t get_bucketSize(minimizer_t minimizer) const;
+		uint32_t get_runCount() const;
+};
+
+inline uint32_t ExternalBuckets::get_runCount() const {
+	return runCount;
+}
+
+#endif
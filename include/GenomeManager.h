@@ -32,21 +32,43 @@
 
 #include <string>
 #include <unordered_map>
+#include <memory>
 #include "Sequence.h"
+#include "ReferenceIndex.h"
+#include "ExternalBuckets.h"
 
 class GenomeManager {
 	private:
 		std::vector<Sequence> genomes;
 		BucketManager bucketManagerGenomes;
+		std::unique_ptr<ExternalBuckets> externalBuckets;
     	uint32_t genomeCount;
 
+		// Copies of the buckets per NUMA node (--numa), nullptr for the node of bucketManagerGenomes
+		std::vector<std::unique_ptr<BucketManager>> replicas;
+
+		void distribute_numa(const Parameters &params);
+
 	public:
-		GenomeManager(std::string genomesfname, std::vector<Seed> &seeds);
-		BucketManager get_BucketManager();
+		// With a memory limit, words are spilled to disk if they do not fit into half of the limit.
+		// References are registered in registry.
+		GenomeManager(std::string genomesfname, std::vector<Seed> &seeds, SequenceRegistry &registry, const Parameters &params);
+
+		// Take the words of all references from the index (which is empty afterwards).
+		GenomeManager(ReferenceIndex &referenceIndex, SequenceRegistry &registry, const Parameters &params);
+
+		// Buckets of all references, with --numa the copy on the node of the calling thread.
+		BucketManager& get_BucketManager();
+
+		// Buckets on disk if words were spilled, otherwise nullptr and all words are in get_BucketManager.
+		ExternalBuckets* get_ExternalBuckets();
 
 		// Getter and Setter
 		std::vector<Sequence>& get_genomes();
 		uint32_t get_genomeCount() const;
+
+		// Number of spaced words of all references, in memory or on disk.
+		uint64_t get_wordCount();
 };
 
 #endif
\ No newline at end of file
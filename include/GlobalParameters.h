@@ -53,15 +53,36 @@ namespace fswm_params {
 	// Number of reads that are processed at once
 	extern uint32_t g_readBlockSize;
 
+	// Toggles if the read block size and number of concurrent partitions are chosen automatically
+	extern bool g_autoReadBlockSize;
+
+	// Memory in bytes for the words of references and queries (0 is unlimited)
+	extern uint64_t g_memoryLimit;
+
+	// Folder of temporary files, e.g. reference buckets spilled under the memory limit
+	extern std::string g_tmpfoldername;
+
+	// Placement of reference buckets on NUMA nodes: off, replicate or interleave
+	extern std::string g_numaMode;
+
 	// Toggles verbose mode with additional comments to std::cout
 	extern bool g_verbose;
 
 	// Toggles if a histogram of spaced word matches is written to file
 	extern bool g_writeHistogram;
 
+	// Toggles if the histogram is written per read/reference pair instead of only per score
+	extern bool g_histogramPerPair;
+
 	// Toggles if scoring list and table are written to files
 	extern bool g_writeScoring;
 
+	// Toggles if a JSON report with timings and counters of all phases is written to file
+	extern bool g_writeReport;
+
+	// Format of written scores: text (scoring list and table) or binary (float32 matrix)
+	extern std::string g_scoresFormat;
+
 	// Toggles if a histogram of spaced word matches is written to file
 	extern bool g_writeParameter;
 
@@ -89,12 +110,35 @@ namespace fswm_params {
 	// Number of automatically optimized patterns used
 	extern int g_numPatterns;
 
+	// Seed of the random pattern optimization
+	extern uint32_t g_patternSeed;
+
+	// File with patterns that are used instead of optimized patterns
+	extern std::string g_patternfname;
+
+	// Folder in which optimized patterns are cached (empty disables the cache)
+	extern std::string g_patternCache;
+
 	// Branch lengths of placed queries in fast placement mode; deprecated
 	extern double g_defaultDistance;
 
 	// X for SpaM-X placement
 	extern double g_spam_X;
 
+	// Number of references with most spaced word matches that are kept per query (0 keeps all)
+	extern uint32_t g_topReferences;
+
+	// Word pairs compared at most for a read and a genome word group (0 compares all), and whether
+	// larger groups are sampled down to about this many pairs or skipped: sample or skip
+	extern uint64_t g_maxGroupPairs;
+	extern std::string g_largeGroups;
+
+	// Toggles if queries with identical sequences are placed once and written with all names
+	extern bool g_dereplicate;
+
+	// Maximum number of weighted placements written per query
+	extern uint32_t g_numPlacements;
+
 	// Full file names of input files
 	extern std::string g_genomesfname;
 	extern std::string g_reftreefname;
@@ -102,38 +146,77 @@ namespace fswm_params {
 	extern std::string g_outjplacename;
 	extern std::string g_outfoldername;
 	extern std::string g_paramfname;
+	extern std::string g_indexfoldername;
+
+	// Format of placement output file: jplace, jplace.gz or binary
+	extern std::string g_outputFormat;
 
 	// Set default distance of new branch for phylogenetic distance
 	extern double default_distance_new_leaves;
 }
 
-// Mappings of internally used ids to names of input sequences.
-namespace fswm_internal {
-	extern std::unordered_map<seq_id_t, std::string> seqIDsToNames;
-	extern std::unordered_map<std::string, seq_id_t> namesToSeqIDs;
-
-	extern std::unordered_map<seq_id_t, std::string> genomeIDsToNames;
-	extern std::unordered_map<std::string, seq_id_t> namesToGenomeIDs;
+// Copy of all parameters, e.g. taken by a PlacementEngine when it is created. Everything
+// below the engine reads its parameters from such a copy, so neither later changes of
+// fswm_params nor other engines of the same process affect a run.
+struct Parameters {
+	uint16_t weight;
+	uint16_t spaces;
+	std::string assignmentMode;
+	uint16_t threads;
+	uint32_t readBlockSize;
+	bool autoReadBlockSize;
+	uint64_t memoryLimit;
+	std::string tmpfoldername;
+	std::string numaMode;
+	bool verbose;
+	bool writeHistogram;
+	bool histogramPerPair;
+	bool writeScoring;
+	bool writeReport;
+	std::string scoresFormat;
+	bool writeParameter;
+	bool writeIDs;
+	int filteringThreshold;
+	int filteringThresholdMultiplicator;
+	bool sampling;
+	int minHashLowerLimit;
+	bool draftGenomes;
+	std::string delimiter;
+	int numPatterns;
+	uint32_t patternSeed;
+	std::string patternfname;
+	std::string patternCache;
+	double defaultDistance;
+	double spamX;
+	uint32_t topReferences;
+	uint64_t maxGroupPairs;
+	std::string largeGroups;
+	bool dereplicate;
+	uint32_t numPlacements;
+	std::string genomesfname;
+	std::string reftreefname;
+	std::string readsfname;
+	std::string outjplacename;
+	std::string outfoldername;
+	std::string paramfname;
+	std::string indexfoldername;
+	std::string outputFormat;
+	double defaultDistanceNewLeaves;
+};
 
-	extern std::unordered_map<seq_id_t, std::string> readIDsToNames;
-	extern std::unordered_map<std::string, seq_id_t> namesToReadIDs;
-
-	extern std::unordered_map<seq_id_t, seq_id_t> placementIDsToIDs;
-	extern std::unordered_map<seq_id_t, seq_id_t> IDsToPlacementIDs;
-	extern int g_numberGenomes;
-	extern bool jplace_tracking;
-}
+class Sequence;
+class SequenceRegistry;
 
 class GlobalParameters {
 	public:
-		// Save parameters to default txt file.
-		static bool save_parameters();
+		// Save parameters to default txt file in the output folder of params.
+		static bool save_parameters(const Parameters &params);
 
 		// Load parameters from txt file given as argument.
 		static bool load_parameters(std::string filename);
 
 		// Check parameters for correctness.
-		static bool check_parameters();
+		static bool check_parameters(bool queriesRequired = true);
 
 		// Parse command line parameters.
 		static bool parse_parameters(int argc, char *argv[]);
@@ -141,16 +224,29 @@ class GlobalParameters {
 		// Print set of parametes to std::out.
 		static bool print_to_console();
 
+		// Copy of the current values of fswm_params.
+		static Parameters get_parameters();
+
 		// Print help.txt as manual and exit.
 		static void print_help();
 
-		// Write mapping of sequence names to their internal ids to file.
-		static void write_genome_ids_to_file();
-		static void write_seq_ids_to_file();
-		static void write_read_ids_to_file();
+		// Write mapping of sequence names to their internal ids to file in outfoldername.
+		static void write_genome_ids_to_file(std::string outfoldername, const SequenceRegistry &registry);
+		static void write_seq_ids_to_file(std::string outfoldername, const SequenceRegistry &registry);
+		static void write_read_ids_to_file(std::string outfoldername, const std::vector<Sequence> &reads);
 
 		// Calculates threshold for spaced word filter.
 		static int calculate_filteringThreshold();
+		static void calculate_filteringThreshold(Parameters &params);
+
+		// Default folder of the pattern cache.
+		static std::string default_patternCache();
+
+		// Parse a number of bytes with an optional suffix K, M, G or T, 0 if invalid.
+		static uint64_t parse_bytes(std::string value);
+
+		// Parse a non-negative integer of at most max, false if invalid.
+		static bool parse_number(std::string value, uint64_t max, uint64_t &number);
 };
 
 #endif
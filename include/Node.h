@@ -20,6 +20,7 @@
 #include <vector>
 #include <iostream>
 #include "Word.h"
+#include "SequenceRegistry.h"
 
 struct Node {
 	std::string name;				// Node name should be identical to reference sequence name for leaves
@@ -31,7 +32,8 @@ struct Node {
 	count_t leaves_below;
 	double distance;				// Distance from father node to this node
 
-	Node(std::string name);
+	// Leaves take the ID of the reference with the same name, other nodes get a new ID of registry.
+	Node(std::string name, SequenceRegistry &registry);
 
 	bool add_child(Node *child);
 	bool remove_child(Node *child);
@@ -0,0 +1,72 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * NUMA nodes of the machine and pinning of threads to them. Nodes and their
+ * CPUs are read from /sys/devices/system/node, so replication by first touch
+ * works without libnuma. Interleaving memory needs libnuma (HAVE_NUMA).
+ *
+ * Threads remember the node they are pinned to, which is used to pick the
+ * closest replica of the reference buckets.
+ *
+ * Example:
+ * 	uint32_t node = NumaTopology::get_thread_node(omp_get_thread_num(), omp_get_num_threads());
+ * 	NumaTopology::pin_thread(node);
+ * 	...
+ * 	NumaTopology::unpin_thread();
+ */
+#ifndef FSWM_NUMATOPOLOGY_H_
+#define FSWM_NUMATOPOLOGY_H_
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class NumaTopology {
+	private:
+		static thread_local uint32_t threadNode;
+
+	public:
+		// CPUs of every node that has CPUs the process may run on. A single node if there is no NUMA information.
+		static const std::vector<std::vector<int>>& get_nodes();
+		static uint32_t get_nodeCount();
+
+		// Node of thread threadNum of threads. Threads are spread round robin, so that
+		// the first threads (which take partitions) are on different nodes.
+		static uint32_t get_thread_node(int threadNum, int threads);
+
+		// Pin calling thread to the CPUs of a node, or allow all CPUs of the process again.
+		static bool pin_thread(uint32_t node);
+		static void unpin_thread();
+
+		// Node the calling thread is pinned to (0 if it is not pinned).
+		static uint32_t get_current_node();
+
+		// Allocate memory of the calling thread interleaved over all nodes, or on the local node again. False without libnuma.
+		static bool set_interleaved_allocation(bool interleaved);
+		static bool interleave_available();
+};
+
+inline uint32_t NumaTopology::get_nodeCount() {
+	return get_nodes().size();
+}
+
+inline uint32_t NumaTopology::get_current_node() {
+	return threadNode;
+}
+
+#endif
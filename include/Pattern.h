@@ -22,6 +22,7 @@
 #include <iostream>
 #include <fstream>
 #include <random>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <math.h>
@@ -84,6 +85,10 @@ class Pattern{
 
 
 	private:
+		std::default_random_engine generator;
+		std::vector<uint64_t> masks;					/*Match positions of each pattern as bitmask*/
+		std::vector<double> pow_p;
+		std::vector<double> pow_q;
 		std::vector<std::vector<double> > q_values;
 		std::vector<std::vector<std::string> > seq_matrix;
 		std::vector<std::string> pattern_set;
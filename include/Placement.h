@@ -22,14 +22,22 @@
 #include <unordered_map>
 #include "Word.h"
 
-
-
-
+class ReadManager;
+class GenomeManager;
 
 class Placement {
 	public:
-		static void phylogenetic_placement();
-		static void create_output_files();
+		// Set read block size of readManager (chosen in auto mode, reduced under a memory limit), returns number of
+		// concurrent partitions. params are not changed, so every batch starts from the given block size.
+		static int plan_partitions(ReadManager &readManager, GenomeManager &genomeManager, const Parameters &params);
+
+		// Patterns of the pattern file, or optimized patterns of the weight, don't cares and number of params (cached if
+		// possible). With a pattern file, weight, don't cares and number of patterns of params are set to those of the file.
+		static std::vector<std::string> create_patterns(Parameters &params);
+
+		// Read and validate patterns from file, false with reason in error if the file is not a valid pattern set.
+		static bool load_patterns(std::string filename, std::vector<std::string> &patterns, std::string &error);
+		static bool save_patterns(std::string filename, const std::vector<std::string> &patterns);
 };
 
 #endif
@@ -0,0 +1,129 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Long-lived placement engine that loads patterns, references and the reference
+ * tree once and places any number of query batches against them.
+ *
+ * The engine keeps its own copy of the parameters it is constructed with (e.g.
+ * taken from fswm_params by GlobalParameters::get_parameters), so later changes
+ * of fswm_params do not affect it. Patterns and the reference index are loaded by
+ * the constructor; references and tree by load_references, which is called by the
+ * first place or place_file if not called before. Queries of such a first batch
+ * get the lowest sequence IDs, exactly as in the command line tool, all later
+ * batches reuse the IDs after the nodes of the tree.
+ *
+ * Several engines can exist in one process. Batches of an engine are placed one
+ * after another; every batch is placed with all threads.
+ *
+ * Example:
+ * 	GlobalParameters::parse_parameters(argc, argv);
+ * 	PlacementEngine engine(GlobalParameters::get_parameters());
+ * 	engine.load_references();
+ * 	for (auto const &batch : batches) {
+ * 		std::vector<QueryPlacement> placements = engine.place(batch);
+ * 	}
+ */
+#ifndef FSWM_PLACEMENTENGINE_H_
+#define FSWM_PLACEMENTENGINE_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "Seed.h"
+#include "Tree.h"
+#include "ReadManager.h"
+#include "GenomeManager.h"
+#include "ReferenceIndex.h"
+#include "ScoringWriter.h"
+#include "ScoreHistogram.h"
+#include "PlacementWriter.h"
+#include "SequenceRegistry.h"
+
+struct QueryPlacement {
+	std::string name;
+
+	// Weighted placements with the edge numbers of the JPlace tree, empty if the query was not placed
+	std::vector<PlacementRecord> placements;
+};
+
+class PlacementEngine {
+	private:
+		// Parameters of this engine, with weight, don't cares and patterns of the index or pattern file
+		Parameters params;
+
+		// Sequence IDs and names of the references and tree nodes of this engine
+		SequenceRegistry registry;
+
+		std::vector<std::string> patterns;
+		std::vector<Seed> seeds;
+		std::unique_ptr<ReferenceIndex> referenceIndex;
+		std::unique_ptr<GenomeManager> genomeManager;
+		std::unique_ptr<Tree> tree;
+		std::string jplaceTree;
+
+		// Compare, calculate distances and place all partitions of the queries in parallel.
+		// Placed partitions are handed to finish_partition one at a time.
+		void place_partitions(ReadManager &readManager, ScoreHistogram *histogram, ScoringWriter *scoringWriter,
+				std::function<void(Scoring&)> finish_partition);
+
+	public:
+		// Create patterns or load the reference index given in parameters.
+		PlacementEngine(const Parameters &parameters);
+		PlacementEngine(const PlacementEngine&) = delete;
+		PlacementEngine& operator=(const PlacementEngine&) = delete;
+
+		// Create spaced words of the references (or take them from the index) and read the reference tree.
+		void load_references();
+		bool references_loaded() const;
+
+		// Place queries given as pairs of name and nucleotide sequence, placements are in the order of the queries.
+		std::vector<QueryPlacement> place(const std::vector<std::pair<std::string, std::string>> &queries);
+
+		// Place queries of a fasta file and write placements, scores, histogram and report as set in the parameters.
+		void place_file(std::string readsfname);
+
+		const Parameters& get_parameters() const;
+		const std::vector<std::string>& get_patterns() const;
+		Tree& get_tree();
+
+		// Reference tree in newick format with the edge numbers used in placements, as in JPlace files.
+		const std::string& get_jplace_tree() const;
+};
+
+inline bool PlacementEngine::references_loaded() const {
+	return (bool) tree;
+}
+
+inline const Parameters& PlacementEngine::get_parameters() const {
+	return params;
+}
+
+inline const std::vector<std::string>& PlacementEngine::get_patterns() const {
+	return patterns;
+}
+
+inline Tree& PlacementEngine::get_tree() {
+	return *tree;
+}
+
+inline const std::string& PlacementEngine::get_jplace_tree() const {
+	return jplaceTree;
+}
+
+#endif
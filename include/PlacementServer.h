@@ -0,0 +1,80 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Placement server that keeps references and tree of a PlacementEngine resident
+ * and places query batches sent over a Unix domain socket.
+ *
+ * Protocol: a client connects, sends queries in fasta format and closes its
+ * writing side. The server answers with a JSON object whose "placements" array
+ * holds the JPlace placements of all placed queries, or {"error": "..."}, and
+ * closes the connection. A request consisting of the line TREE is answered with
+ * the reference tree with the JPlace edge numbers of the placements.
+ *
+ * Connections are handled by a pool of workers that read requests and write
+ * answers in parallel; batches are placed one after another with all threads.
+ * At most queueSize accepted connections wait for a worker. While the queue is
+ * full no further connections are accepted, so clients wait in the listen
+ * backlog (backpressure) instead of the server growing without bound.
+ *
+ * Example:
+ * 	./appspam serve -i panel --socket /tmp/appspam.sock
+ * 	socat - UNIX-CONNECT:/tmp/appspam.sock < queries.fasta
+ */
+#ifndef FSWM_PLACEMENTSERVER_H_
+#define FSWM_PLACEMENTSERVER_H_
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "PlacementEngine.h"
+
+class PlacementServer {
+	private:
+		PlacementEngine &engine;
+		std::string socketfname;
+		uint32_t workers;
+		uint32_t queueSize;
+		int listenSocket;
+
+		// Accepted connections waiting for a worker
+		std::deque<int> connections;
+		std::mutex connectionsMutex;
+		std::condition_variable connectionsNotEmpty;
+		std::condition_variable connectionsNotFull;
+		bool stopping;
+
+		// Batches are placed one after another, the engine uses all threads for each batch
+		std::mutex engineMutex;
+
+		void work();
+		void handle_connection(int connection);
+		std::string answer_request(const std::string &request);
+
+	public:
+		PlacementServer(PlacementEngine &engine, std::string socketfname, uint32_t workers, uint32_t queueSize);
+		~PlacementServer();
+
+		// Accept and answer requests until SIGINT or SIGTERM.
+		void run();
+
+		// Entry point of "appspam serve".
+		static int serve_command(int argc, char *argv[]);
+};
+
+#endif
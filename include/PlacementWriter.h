@@ -0,0 +1,118 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Streams placements to one of the supported output formats:
+ * 	jplace     Pretty-printed JPlace text file (default).
+ * 	jplace.gz  Same JPlace text, gzip compressed while writing.
+ * 	binary     Compact binary placement file that can be converted
+ * 	           to JPlace later with appspam_convert.
+ *
+ * Binary format (native byte order):
+ * 	header:  "APPSPAMP", uint32 byte order mark, uint32 version, uint32 + bytes metadata,
+ * 	         uint32 + bytes tree
+ * 	records: 'N' uint32 query index, uint32 mass, uint32 + bytes query name
+ * 	         'P' uint32 query index, uint32 edge, float distal, float pendant, float weight
+ * The 'P' records of a query directly follow its 'N' record. Queries with several
+ * names (identical sequences with --dereplicate) have one 'N' record per name.
+ * Files are only converted on machines with the byte order of the writing one.
+ */
+#ifndef FSWM_PLACEMENTWRITER_H_
+#define FSWM_PLACEMENTWRITER_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "GlobalParameters.h"
+
+struct PlacementRecord {
+	uint32_t edge;
+	double distal_length;
+	double pendant_length;
+	double weight;
+};
+
+class PlacementWriter {
+	private:
+		std::string format;
+		std::string filename;
+		FILE *file;
+		void *gzStream;
+		bool first;
+		std::string buffer;
+
+		void write_raw(const char *data, size_t size);
+		void write_string(const std::string &str);
+		void write_uint32(uint32_t value);
+		void write_float(float value);
+		void flush_buffer();
+		void close_file();
+		void write_failed();
+
+	public:
+		static const uint32_t binaryVersion = 2;
+		static const uint32_t byteOrderMark = 0x01020304;
+
+		PlacementWriter(std::string filename, std::string format);
+		~PlacementWriter();
+
+		// Write everything before the placements. Metadata is the body of the JPlace metadata object.
+		void write_beginning(const std::string &metadata, const std::string &tree);
+
+		// Write all placements of one query, or of several queries with identical sequences (each with the mass).
+		void write_placement(uint32_t queryIndex, const std::string &name, const std::vector<PlacementRecord> &placements, uint32_t mass);
+		void write_placement(uint32_t queryIndex, const std::vector<std::string> &names, const std::vector<PlacementRecord> &placements,
+				uint32_t mass);
+
+		// Write everything after the placements and close the file.
+		void write_end();
+
+		std::string get_filename() const;
+
+		// JPlace placement object of one or several queries (without separating comma).
+		static std::string format_jplace_placement(const std::string &name, const std::vector<PlacementRecord> &placements, uint32_t mass);
+		static std::string format_jplace_placement(const std::vector<std::string> &names, const std::vector<PlacementRecord> &placements,
+				uint32_t mass);
+
+		// Escape a string (e.g. a query name) for use inside JSON quotes.
+		static std::string json_escape(const std::string &str);
+
+		// Return output file name for a format, e.g. with .gz appended for jplace.gz.
+		static std::string get_output_filename(std::string filename, std::string format);
+
+		// Check if format is supported by this build.
+		static bool format_supported(std::string format);
+
+		// Convert binary placement file to JPlace (format jplace or jplace.gz).
+		static bool convert_binary(std::string binaryfname, std::string outfname, std::string format);
+};
+
+inline void PlacementWriter::write_placement(uint32_t queryIndex, const std::string &name,
+		const std::vector<PlacementRecord> &placements, uint32_t mass) {
+	write_placement(queryIndex, std::vector<std::string>(1, name), placements, mass);
+}
+
+inline std::string PlacementWriter::format_jplace_placement(const std::string &name,
+		const std::vector<PlacementRecord> &placements, uint32_t mass) {
+	return format_jplace_placement(std::vector<std::string>(1, name), placements, mass);
+}
+
+inline std::string PlacementWriter::get_filename() const {
+	return filename;
+}
+
+#endif
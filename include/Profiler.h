@@ -0,0 +1,116 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Records wall and CPU time per phase of a run together with some counters
+ * (words per bucket, candidate pairs, filtered matches) and writes them as
+ * JSON run report. Phases are timed with a ProfilerTimer on the stack.
+ * Times of phases running in several threads are summed over all threads.
+ */
+#ifndef FSWM_PROFILER_H_
+#define FSWM_PROFILER_H_
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include "GlobalParameters.h"
+
+class Profiler {
+	public:
+		enum Phase {
+			PATTERN_OPTIMIZATION,
+			REFERENCE_PARSING,
+			QUERY_PARSING,
+			FILL_BUCKETS,
+			BUCKET_SORT_GROUP,
+			BUCKET_SPILL,
+			NUMA_DISTRIBUTION,
+			BUCKET_JOIN,
+			DISTANCE_CALCULATION,
+			TREE_PLACEMENT,
+			JPLACE_WRITING,
+			NUM_PHASES
+		};
+
+		enum Counter {
+			PARTITIONS,
+			CANDIDATE_PAIRS,
+			FILTERED_MATCHES,
+			LARGE_GROUPS,
+			SKIPPED_PAIRS,
+			NUM_COUNTERS
+		};
+
+		static void add_phase_time(Phase phase, uint64_t wallNanoseconds, uint64_t cpuNanoseconds);
+		static void add_count(Counter counter, uint64_t count);
+
+		// Record number of reference and query words of one bucket comparison.
+		static void add_bucket_words(minimizer_t minimizer, uint64_t referenceWords, uint64_t queryWords);
+
+		// Add a string value (e.g. block size) to the report.
+		static void set_info(std::string key, std::string value);
+
+		// Write JSON report of all phases and counters and the peak resident set size.
+		static void write_report(std::string filename);
+
+		// Thread CPU time in nanoseconds.
+		static uint64_t thread_cpu_time();
+
+	private:
+		static std::chrono::steady_clock::time_point start;
+		static std::atomic<uint64_t> phaseCalls[NUM_PHASES];
+		static std::atomic<uint64_t> phaseWall[NUM_PHASES];
+		static std::atomic<uint64_t> phaseCpu[NUM_PHASES];
+		static std::atomic<uint64_t> counters[NUM_COUNTERS];
+};
+
+/**
+ * Adds wall and CPU time between construction and destruction to a phase.
+ */
+class ProfilerTimer {
+	private:
+		Profiler::Phase phase;
+		std::chrono::steady_clock::time_point wallStart;
+		uint64_t cpuStart;
+
+	public:
+		ProfilerTimer(Profiler::Phase phase);
+		~ProfilerTimer();
+};
+
+inline ProfilerTimer::ProfilerTimer(Profiler::Phase phase) {
+	this->phase = phase;
+	this->wallStart = std::chrono::steady_clock::now();
+	this->cpuStart = Profiler::thread_cpu_time();
+}
+
+inline ProfilerTimer::~ProfilerTimer() {
+	uint64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wallStart).count();
+	Profiler::add_phase_time(phase, wall, Profiler::thread_cpu_time() - cpuStart);
+}
+
+inline void Profiler::add_phase_time(Phase phase, uint64_t wallNanoseconds, uint64_t cpuNanoseconds) {
+	phaseCalls[phase] += 1;
+	phaseWall[phase] += wallNanoseconds;
+	phaseCpu[phase] += cpuNanoseconds;
+}
+
+inline void Profiler::add_count(Counter counter, uint64_t count) {
+	counters[counter] += count;
+}
+
+#endif
@@ -17,38 +17,84 @@
 /**
  * Functionality:
  * Reads the sequences in partitions instead of all at once. 
- * Delivers the BucketManager of partitions one after another 
- * via get_next_partition_BucketManager.
+ * Delivers the BucketManager of any partition via get_partition_BucketManager,
+ * partitions can be processed in any order and in parallel.
  *
  * Example:
- * 	ReadManager	readManager(readBlockSize, readsfname);
+ * 	ReadManager	readManager(readsfname, registry, params);
  * 	for (int currentPartition = 0; currentPartition < readManager.get_partitions(); currentPartition++) {
- * 		BucketManager bucketManagerReads = readManager.get_next_partition_BucketManager(seed);
+ * 		BucketManager bucketManagerReads;
+ * 		std::vector<std::string> readNames;
+ * 		std::vector<seq_id_t> readIDs = readManager.get_partition_BucketManager(currentPartition, seeds, bucketManagerReads, readNames);
  *	}
  *
+ * With --dereplicate, queries with identical sequences are kept only once as
+ * read (under the first name), the names of the other copies are delivered
+ * with the partition so placements can be written for all of them.
  */
 #ifndef FSWM_READMANAGER_H_
 #define FSWM_READMANAGER_H_
 
 #include <string>
 #include "Sequence.h"
+#include "SequenceRegistry.h"
 
 class ReadManager {
 	private:
+		const Parameters &params;
 		std::vector<Sequence> reads;
+		uint32_t readBlockSize;
     	uint32_t partitions;
-    	uint32_t currentPartition;
-    	uint32_t currentSeq;
     	uint32_t readCount;
 
+		// With dereplication: names of further queries with the sequence of each read,
+		// and the read of every query in input order. Empty otherwise.
+		std::vector<std::vector<std::string>> duplicateNames;
+		std::vector<uint32_t> queryReads;
+
+		void dereplicate(SequenceRegistry &registry);
+
 	public:
-		ReadManager(std::string readsfname);
-		std::vector<seq_id_t> get_next_partition_BucketManager(std::vector<Seed> &seeds, BucketManager &bucketManagerReads);
+		// Reads get the next sequence IDs of registry, partitions have params.readBlockSize reads.
+		ReadManager(std::string readsfname, SequenceRegistry &registry, const Parameters &params);
+
+		// Queries given as pairs of name and nucleotide sequence.
+		ReadManager(const std::vector<std::pair<std::string, std::string>> &queries, SequenceRegistry &registry,
+				const Parameters &params);
+
+		// Fill BucketManager with the words of a partition and append the names of its reads to readNames,
+		// and the names of their duplicates to duplicateNames if given. Returns the (consecutive) IDs of the reads.
+		std::vector<seq_id_t> get_partition_BucketManager(uint32_t partition, std::vector<Seed> &seeds,
+				BucketManager &bucketManagerReads, std::vector<std::string> &readNames,
+				std::vector<std::vector<std::string>> *duplicateNames = nullptr);
+
+		// Number of spaced words of all reads for the given number of patterns and pattern length.
+		uint64_t get_wordCount(int numPatterns, int patternLength) const;
+
+		// Change number of reads per partition, only before the first partition.
+		void set_readBlockSize(uint32_t readBlockSize);
+		uint32_t get_readBlockSize() const;
 
 		// Getter and Setter
 		std::vector<Sequence>& get_reads();
 		uint32_t get_partitions() const;
 		uint32_t get_readCount() const;
+
+		// Number of queries before dereplication, and index of the read of a query (in input order).
+		uint32_t get_queryCount() const;
+		uint32_t get_queryRead(uint32_t query) const;
 };
 
+inline uint32_t ReadManager::get_readBlockSize() const {
+	return readBlockSize;
+}
+
+inline uint32_t ReadManager::get_queryCount() const {
+	return queryReads.empty() ? reads.size() : queryReads.size();
+}
+
+inline uint32_t ReadManager::get_queryRead(uint32_t query) const {
+	return queryReads.empty() ? query : queryReads[query];
+}
+
 #endif
\ No newline at end of file
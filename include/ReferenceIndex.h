@@ -0,0 +1,113 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Persistent index of reference sequences: the sorted spaced words of all
+ * references per minimizer bucket, their names, the patterns and all
+ * parameters that words depend on. References can be added and removed
+ * without extracting the spaced words of the other references again.
+ *
+ * Words are kept in the order of Bucket::word_order, so an index updated by
+ * adding and removing references holds the same words in the same order as an
+ * index created from the final references at once.
+ *
+ * References have index IDs that never change while they are in the index.
+ * New references get IDs after the largest ID ever used. When placing, the
+ * index IDs are mapped in their order to the sequence IDs following the reads,
+ * exactly as if the references were read from a fasta file.
+ *
+ * An index is a folder with the files:
+ * 	references.idx  binary words and names (see save)
+ * 	tree.nwk        reference tree used when no tree is given
+ *
+ * Example:
+ * 	./appspam index -i panel --add refs.fasta --tree tree.nwk
+ * 	./appspam index -i panel --add new_refs.fasta --tree new_tree.nwk
+ * 	./appspam index -i panel --remove old_ref1,old_ref2
+ * 	./appspam -i panel -q queries.fasta
+ */
+#ifndef FSWM_REFERENCEINDEX_H_
+#define FSWM_REFERENCEINDEX_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include "BucketManager.h"
+#include "SequenceRegistry.h"
+
+class ReferenceIndex {
+	private:
+		uint16_t weight;
+		uint16_t spaces;
+		bool sampling;
+		int32_t hashLimit;
+		bool draftGenomes;
+		std::string delimiter;
+		seq_id_t nextID;
+		std::vector<std::string> patterns;
+
+		// Names of references by index ID
+		std::map<seq_id_t, std::string> genomeIDsToNames;
+
+		// Words of all references per minimizer in the order of Bucket::word_order
+		std::vector<std::vector<Word>> buckets;
+
+	public:
+		static const uint32_t binaryVersion = 1;
+
+		// Empty index with the given patterns and the weight, don't cares, sampling and unassembled references of params.
+		ReferenceIndex(const std::vector<std::string> &patterns, const Parameters &params);
+		ReferenceIndex();
+
+		// Read index from folder, false if the folder contains no valid index.
+		bool load(std::string foldername);
+		bool save(std::string foldername) const;
+
+		// Add words of all sequences in fasta file (params as set by apply_parameters), returns number of new references.
+		uint32_t add_references(std::string fastafname, const Parameters &params);
+
+		// Remove references with given names, returns number of removed references.
+		uint32_t remove_references(const std::unordered_set<std::string> &names);
+
+		// Set params to the parameters of the index (weight, don't cares, sampling, unassembled references).
+		void apply_parameters(Parameters &params) const;
+
+		// Move all words into bucketManager with the next sequence IDs of registry
+		// and register the names of the references. The index is empty afterwards.
+		void move_to_BucketManager(BucketManager &bucketManager, SequenceRegistry &registry);
+
+		const std::vector<std::string>& get_patterns() const;
+		const std::map<seq_id_t, std::string>& get_genomes() const;
+		uint64_t get_wordCount() const;
+
+		static std::string get_index_filename(std::string foldername);
+		static std::string get_tree_filename(std::string foldername);
+
+		// Entry point of "appspam index".
+		static int index_command(int argc, char *argv[]);
+};
+
+inline const std::vector<std::string>& ReferenceIndex::get_patterns() const {
+	return patterns;
+}
+
+inline const std::map<seq_id_t, std::string>& ReferenceIndex::get_genomes() const {
+	return genomeIDsToNames;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Aggregated histogram of spaced word match scores. Counts are kept per
+ * score and, if requested, per read/reference pair. Every partition fills
+ * its own histogram, which is merged into the global one afterwards, so
+ * no file is touched while matching.
+ */
+#ifndef FSWM_SCOREHISTOGRAM_H_
+#define FSWM_SCOREHISTOGRAM_H_
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "GlobalParameters.h"
+
+class ScoreHistogram {
+	private:
+		int minScore;
+		std::vector<uint64_t> counts;
+
+		// Sparse histograms per read/reference pair, key is (read ID << 32 | reference ID)
+		bool perPair;
+		std::unordered_map<uint64_t, std::unordered_map<int, uint64_t>> pairCounts;
+
+	public:
+		// Bins for the don't care positions of params, per read/reference pair with params.histogramPerPair.
+		ScoreHistogram(const Parameters &params);
+
+		void add(int score, seq_id_t readID, seq_id_t genomeID);
+
+		// Add all counts of other histogram to this one.
+		void merge(const ScoreHistogram &other);
+
+		// Write non-empty bins to file (score and count, or read, reference, score and count per pair).
+		void write_to_file(std::string filename) const;
+};
+
+inline void ScoreHistogram::add(int score, seq_id_t readID, seq_id_t genomeID) {
+	counts[score - minScore]++;
+	if (perPair) {
+		pairCounts[((uint64_t) readID << 32) | genomeID][score]++;
+	}
+}
+
+#endif
@@ -17,6 +17,7 @@
 #define FSWM_SCORING_H_
 
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <vector>
 #include "Word.h"
@@ -33,6 +34,42 @@ typedef std::unordered_map<seq_id_t,scoring_t> seqIDtoScoring_t;
 // Unordered map from sequence IDs to seqIDtoScoring_t for "matrix"-functionality
 typedef std::unordered_map<seq_id_t,seqIDtoScoring_t> scoringMap_t;
 
+// Unordered map from sequence IDs to (distal, pendant) branch lengths of a placement
+typedef std::unordered_map<seq_id_t,std::pair<double,double>> branchLengthMap_t;
+
+// Unordered map from sequence IDs to weighted placements (node ID and like_weight_ratio) of a read
+typedef std::unordered_map<seq_id_t,std::vector<std::pair<seq_id_t,double>>> placementMap_t;
+
+class Tree;
+class PlacementWriter;
+class SequenceRegistry;
+
+// Score of one spaced word match of a read with a genome, matches of a read word are added in batches
+struct WordMatch {
+	seq_id_t genomeID;
+	int score;
+	int mismatches;
+};
+
+/**
+ * Scores of the spaced word matches found by one task, summed per read and genome.
+ * Pairs are kept in the order of their first match, so adding several of them to a
+ * Scoring in the order of the sequential join gives exactly the same maps.
+ */
+class PartialScoring {
+	private:
+		std::unordered_map<uint64_t, uint32_t> pairIndices;
+
+	public:
+		std::vector<std::pair<seq_id_t, seq_id_t>> pairs;
+		std::vector<scoring_t> scores;
+		std::vector<count_t> mismatches;
+		std::vector<count_t> matches;
+
+		void add_match(seq_id_t readID, seq_id_t genomeID, int score, int mismatchCount);
+		void add_matches(seq_id_t readID, const WordMatch *wordMatches, size_t count);
+};
+
 class Scoring {
 	public:
 		// For each assigned read (first seqID) it records the seqID of the assigned genome or internal leave (second seqID)
@@ -44,12 +81,44 @@ class Scoring {
 		countMap_t mismatchCount;
 		countMap_t spacedWordMatchCount;
 
+		// Distal and pendant branch lengths of reads placed by least-squares placement (APPLES)
+		branchLengthMap_t branchLengths;
+
+		// Weighted placements of reads if more than one placement per read is written
+		placementMap_t weightedPlacements;
+
+		// Names of the reads of this partition, indexed by seqID - firstReadID, and with
+		// dereplication the names of further queries with the same sequence
+		seq_id_t firstReadID;
+		std::vector<std::string> readNames;
+		std::vector<std::vector<std::string>> duplicateNames;
+
+		// References dropped for a read by retain_top_references. Later matches with them are
+		// ignored, so no reference is scored on only a part of its matches.
+		std::unordered_map<seq_id_t, std::unordered_set<seq_id_t>> removedReferences;
+
 		Scoring();
 
+		const std::string& get_readName(seq_id_t readID) const;
+
+		// Add score and mismatches of one spaced word match between a read and a genome.
+		void add_match(seq_id_t readID, seq_id_t genomeID, int score, int mismatches);
+
+		// Add matches of one read with several genomes, looking up the maps of the read only once.
+		void add_matches(seq_id_t readID, const WordMatch *wordMatches, size_t count);
+
+		// Add all matches of a partial scoring.
+		void add_partial(const PartialScoring &partialScoring);
+
 		/**
 		 * Calculate jk-corrected distances between fswm based on mismatch counts.
 		 */
-		void calculate_fswm_distances();
+		void calculate_fswm_distances(const Parameters &params);
+
+		/**
+		 * Keep only the k references with most spaced word matches for every read that has more than limit references.
+		 */
+		void retain_top_references(uint32_t k, uint32_t limit);
 
 		/**
 		 * Assign reads to reference genome based on shortest jk-corrected distance.
@@ -59,7 +128,12 @@ class Scoring {
 		/**
 		 * Assign reads to reference tree of genome.
 		 */
-		void phylogenetic_placement(std::vector<seq_id_t> readIDs);
+		void phylogenetic_placement(std::vector<seq_id_t> readIDs, Tree &tree, const Parameters &params);
+
+		/**
+		 * Write placements of all assigned reads to the jplace file.
+		 */
+		void write_placement_to_jplace(Tree &tree, PlacementWriter &writer);
 
 		/*
 		Assign reads to reference tree of genome (only phylo-kmer based)
@@ -85,12 +159,77 @@ class Scoring {
 		 * Write jk-corrected distances between all reads and genomes to file.
 		 * The file will be located in the specified results-folder (defaul: results) and named scoring.txt
 		 */
-		void write_scoring_to_file();
+		void write_scoring_to_file(const Parameters &params);
 
 		/**
-		 * Write jk-corrected distances between all reads and genomes to file in tab-delimited table.
+		 * Write jk-corrected distances between all reads and genomes (of registry) to file in tab-delimited table.
 		 */
-		void write_scoring_to_file_as_table();
+		void write_scoring_to_file_as_table(const SequenceRegistry &registry, const Parameters &params);
 };
 
+inline const std::string& Scoring::get_readName(seq_id_t readID) const {
+	return readNames[readID - firstReadID];
+}
+
+inline void Scoring::add_match(seq_id_t readID, seq_id_t genomeID, int score, int mismatches) {
+	if (!removedReferences.empty()) {
+		auto removed = removedReferences.find(readID);
+		if (removed != removedReferences.end() and removed->second.count(genomeID) > 0) {
+			return;
+		}
+	}
+	if (scoringMap.find(readID) == scoringMap.end()) {
+		scoringMap[readID] = std::unordered_map<seq_id_t, scoring_t>();
+		mismatchCount[readID] = std::unordered_map<seq_id_t, count_t>();
+		spacedWordMatchCount[readID] = std::unordered_map<seq_id_t, count_t>();
+	}
+	scoringMap[readID][genomeID] += score;
+	mismatchCount[readID][genomeID] += mismatches;
+	spacedWordMatchCount[readID][genomeID] += 1;
+}
+
+inline void Scoring::add_matches(seq_id_t readID, const WordMatch *wordMatches, size_t count) {
+	scoringMap_t::iterator scores = scoringMap.find(readID);
+	if (scores == scoringMap.end()) {
+		scores = scoringMap.insert(std::make_pair(readID, std::unordered_map<seq_id_t, scoring_t>())).first;
+		mismatchCount[readID] = std::unordered_map<seq_id_t, count_t>();
+		spacedWordMatchCount[readID] = std::unordered_map<seq_id_t, count_t>();
+	}
+	seqIDtoCount_t &mismatches = mismatchCount[readID];
+	seqIDtoCount_t &matches = spacedWordMatchCount[readID];
+	const std::unordered_set<seq_id_t> *removed = nullptr;
+	if (!removedReferences.empty()) {
+		auto removed_it = removedReferences.find(readID);
+		removed = removed_it != removedReferences.end() ? &removed_it->second : nullptr;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (removed != nullptr and removed->count(wordMatches[i].genomeID) > 0) {
+			continue;
+		}
+		scores->second[wordMatches[i].genomeID] += wordMatches[i].score;
+		mismatches[wordMatches[i].genomeID] += wordMatches[i].mismatches;
+		matches[wordMatches[i].genomeID] += 1;
+	}
+}
+
+inline void PartialScoring::add_match(seq_id_t readID, seq_id_t genomeID, int score, int mismatchCount) {
+	auto inserted = pairIndices.insert(std::make_pair(((uint64_t) readID << 32) | genomeID, (uint32_t) pairs.size()));
+	if (inserted.second) {
+		pairs.push_back(std::make_pair(readID, genomeID));
+		scores.push_back(0);
+		mismatches.push_back(0);
+		matches.push_back(0);
+	}
+	uint32_t index = inserted.first->second;
+	scores[index] += score;
+	mismatches[index] += mismatchCount;
+	matches[index] += 1;
+}
+
+inline void PartialScoring::add_matches(seq_id_t readID, const WordMatch *wordMatches, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		add_match(readID, wordMatches[i].genomeID, wordMatches[i].score, wordMatches[i].mismatches);
+	}
+}
+
 #endif
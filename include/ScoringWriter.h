@@ -0,0 +1,66 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Writes all query-reference distances to one binary, memory-mappable
+ * float32 matrix with one row per query and one column per reference.
+ * Pairs without spaced word matches are stored as NaN. Partitions write
+ * their own rows at fixed offsets, so no locking is needed.
+ *
+ * Binary format (native byte order, so the matrix can be mapped directly):
+ * 	header:  "APPSPAMS", uint32 byte order mark, uint32 version, uint32 rows, uint32 columns,
+ * 	         float default distance, uint64 offset of matrix
+ * 	names:   for all columns, then all rows: uint32 sequence ID, uint32 + bytes name
+ * 	matrix:  float32 [rows][columns] starting at the matrix offset (multiple of 8)
+ *
+ * The text files scoring_table.txt and scoring_list.txt are created from it with appspam_convert.
+ */
+#ifndef FSWM_SCORINGWRITER_H_
+#define FSWM_SCORINGWRITER_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Scoring.h"
+#include "Sequence.h"
+#include "SequenceRegistry.h"
+
+class ScoringWriter {
+	private:
+		int fd;
+		uint64_t matrixOffset;
+		uint32_t rows;
+		uint32_t columns;
+		std::unordered_map<seq_id_t, uint32_t> genomeIDsToColumns;
+		std::unordered_map<seq_id_t, uint32_t> readIDsToRows;
+
+	public:
+		static const uint32_t binaryVersion = 2;
+		static const uint32_t byteOrderMark = 0x01020304;
+
+		// One column for every genome of registry.
+		ScoringWriter(std::string filename, std::vector<Sequence> &reads, const SequenceRegistry &registry, float defaultDistance);
+		~ScoringWriter();
+
+		// Write the distances of all given reads to their rows.
+		void write_rows(Scoring &scoring, std::vector<seq_id_t> &readIDs);
+
+		// Create scoring_table.txt and scoring_list.txt in outfoldername from binary matrix.
+		static bool convert_to_text(std::string binaryfname, std::string outfoldername);
+};
+
+#endif
@@ -31,7 +31,7 @@ class Seed{
 
 	public:
 		Seed(int32_t weight, int32_t dontCare);
-		bool generate_pattern(std::string &patternStr);
+		bool generate_pattern(std::string &patternStr, bool verbose);
 
 		int32_t get_length();
 		int32_t get_weight();
@@ -18,16 +18,14 @@
 #define FSWM_SEQIO_H_
 
 #include "Sequence.h"
+#include "SequenceRegistry.h"
 
 class SeqIO {
     public:
-    	static seq_id_t seqID_counter;
-        static void read_sequences(std::string fastafname, std::vector<Sequence> &sequences, bool genomes);
-       	static void reset_seqID_counter();
+        // Sequences get the next IDs of registry, genomes are registered with their names
+        // (with params.draftGenomes, contigs with the same name up to params.delimiter form one genome).
+        static void read_sequences(std::string fastafname, std::vector<Sequence> &sequences, bool genomes, SequenceRegistry &registry,
+                const Parameters &params);
 };
 
-inline void SeqIO::reset_seqID_counter() {
-	seqID_counter = -1;
-}
-
 #endif
@@ -37,10 +37,15 @@ class Sequence {
 	public:
 		Sequence(std::string &header, std::string &seqLine, seq_id_t seqID);
 
-		void fill_buckets(std::vector<Seed> &seeds, BucketManager &bucket_manager);
+		void fill_buckets(std::vector<Seed> &seeds, BucketManager &bucket_manager, const Parameters &params);
 
 		std::string get_header() const;
 		seq_id_t get_seqID() const;
+		void set_seqID(seq_id_t seqID);
+		size_t get_length() const;
+
+		// Encoded nucleotides (A=0, C=1, G=2, T=3) without other characters.
+		const std::vector<char>& get_sequence() const;
 };
 
 inline std::string Sequence::get_header() const {
@@ -51,4 +56,16 @@ inline seq_id_t Sequence::get_seqID() const {
 	return seqID;
 }
 
+inline void Sequence::set_seqID(seq_id_t seqID) {
+	this->seqID = seqID;
+}
+
+inline size_t Sequence::get_length() const {
+	return seq.size();
+}
+
+inline const std::vector<char>& Sequence::get_sequence() const {
+	return seq;
+}
+
 #endif
@@ -0,0 +1,109 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Sequence IDs and names of references and tree nodes of one run. Every
+ * PlacementEngine owns its registry, so several engines can exist in one
+ * process. Genomes and tree nodes are registered while references and tree
+ * are loaded and only read afterwards, so lookups during placement need no
+ * locks. Queries only get IDs here, their names are kept per partition (see
+ * Scoring::readNames).
+ *
+ * Reads of the first batch get the lowest IDs, followed by the genomes and
+ * the nodes of the tree, in the order in which they are registered.
+ *
+ * Example:
+ * 	SequenceRegistry registry;
+ * 	seq_id_t genomeID = registry.new_seqID();
+ * 	registry.register_genome(genomeID, name);
+ * 	if (registry.has_genome(name)) { ... }
+ */
+#ifndef FSWM_SEQUENCEREGISTRY_H_
+#define FSWM_SEQUENCEREGISTRY_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "GlobalParameters.h"
+
+class SequenceRegistry {
+	private:
+		// Last sequence ID given out, (seq_id_t) -1 before the first one
+		seq_id_t lastSeqID;
+
+		// Sequence IDs of genomes and tree nodes by name
+		std::unordered_map<std::string, seq_id_t> namesToSeqIDs;
+
+		// Genomes ordered by sequence ID
+		std::vector<std::pair<seq_id_t, std::string>> genomeIDsToNames;
+		std::unordered_map<std::string, seq_id_t> namesToGenomeIDs;
+
+	public:
+		SequenceRegistry();
+
+		// Return the next unused sequence ID.
+		seq_id_t new_seqID();
+
+		// Last sequence ID given out. Setting it gives out the following IDs again (e.g. for the next query batch).
+		seq_id_t get_lastSeqID() const;
+		void set_lastSeqID(seq_id_t seqID);
+
+		// Register name of a genome or tree node.
+		void register_sequence(seq_id_t seqID, const std::string &name);
+		void register_genome(seq_id_t seqID, const std::string &name);
+
+		bool has_sequence(const std::string &name) const;
+		bool has_genome(const std::string &name) const;
+		seq_id_t get_seqID(const std::string &name) const;
+
+		const std::vector<std::pair<seq_id_t, std::string>>& get_genomes() const;
+		const std::unordered_map<std::string, seq_id_t>& get_seqIDs() const;
+};
+
+inline seq_id_t SequenceRegistry::new_seqID() {
+	return ++lastSeqID;
+}
+
+inline seq_id_t SequenceRegistry::get_lastSeqID() const {
+	return lastSeqID;
+}
+
+inline void SequenceRegistry::set_lastSeqID(seq_id_t seqID) {
+	lastSeqID = seqID;
+}
+
+inline bool SequenceRegistry::has_sequence(const std::string &name) const {
+	return namesToSeqIDs.find(name) != namesToSeqIDs.end();
+}
+
+inline bool SequenceRegistry::has_genome(const std::string &name) const {
+	return namesToGenomeIDs.find(name) != namesToGenomeIDs.end();
+}
+
+inline seq_id_t SequenceRegistry::get_seqID(const std::string &name) const {
+	return namesToSeqIDs.at(name);
+}
+
+inline const std::vector<std::pair<seq_id_t, std::string>>& SequenceRegistry::get_genomes() const {
+	return genomeIDsToNames;
+}
+
+inline const std::unordered_map<std::string, seq_id_t>& SequenceRegistry::get_seqIDs() const {
+	return namesToSeqIDs;
+}
+
+#endif
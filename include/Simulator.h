@@ -0,0 +1,90 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Functionality:
+ * Simulates input data for appspam: a random rooted binary tree, reference
+ * sequences evolved along the tree under the Jukes-Cantor model, and query
+ * fragments that branch off at random points of random edges.
+ *
+ * Edges are numbered like in the JPlace output of appspam (post-order, edge
+ * of a node leads to its parent), so the true edge of a query can be compared
+ * directly to the placed edge. Every query is evolved independently from the
+ * parent node of its edge over its distance to the parent plus its pendant length.
+ */
+#ifndef FSWM_SIMULATOR_H_
+#define FSWM_SIMULATOR_H_
+
+#include <string>
+#include <vector>
+#include <random>
+
+struct SimulatedNode {
+	int parent;
+	std::vector<int> children;
+	double length;
+	std::string name;
+	uint32_t edge;
+};
+
+struct SimulatedQuery {
+	std::string name;
+	std::string seq;
+	uint32_t edge;
+	double distal_length;
+	double pendant_length;
+};
+
+class Simulator {
+	private:
+		std::mt19937 generator;
+		std::vector<SimulatedNode> nodes;
+		std::vector<std::string> sequences;
+		int root;
+
+		uint32_t number_edges(int node, uint32_t count);
+		std::string get_newick_recurse(int node) const;
+
+	public:
+		Simulator(unsigned seed);
+
+		// Random rooted binary tree by joining random pairs of subtrees, exponential branch lengths.
+		void simulate_tree(int leaves, double meanBranchLength);
+
+		// Random root sequence evolved to all nodes under Jukes-Cantor.
+		void evolve_sequences(int length);
+
+		// Evolve sequence over branch length t under Jukes-Cantor.
+		std::string evolve(const std::string &seq, double t);
+
+		// Random queries of given length on edges chosen uniformly, exponential pendant lengths.
+		std::vector<SimulatedQuery> simulate_queries(int count, int length, double meanPendantLength);
+
+		std::string get_newick() const;
+		const std::vector<SimulatedNode>& get_nodes() const;
+
+		bool write_references(std::string filename) const;
+		bool write_tree(std::string filename) const;
+
+		// Write edge number, parent edge number, length and name of all nodes (parent edge of root is -1).
+		bool write_edges(std::string filename) const;
+};
+
+inline const std::vector<SimulatedNode>& Simulator::get_nodes() const {
+	return nodes;
+}
+
+#endif
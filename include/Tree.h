@@ -22,21 +22,36 @@
 #include "Scoring.h"
 #include "BucketManager.h"
 #include "Algorithms.h"
+#include "PlacementWriter.h"
 
 class Tree {
 	private:
+		const Parameters &params;
 		Node *root;
 		int internalNodeCounter;
 		bool is_rooted;
 
-		bool parse_newick_tree(std::string treeStr);
+		// Indices of the children of each node in dfs_iterator
+		std::vector<std::vector<int>> dfsChildIndices;
+
+		// Mapping of node IDs to nodes for find_node
+		std::unordered_map<seq_id_t, Node*> idsToNodes;
+
+		// JPlace edge numbers indexed by node ID and node IDs indexed by edge number
+		std::vector<uint32_t> IDsToPlacementIDs;
+		std::vector<seq_id_t> placementIDsToIDs;
+
+		bool parse_newick_tree(std::string treeStr, SequenceRegistry &registry);
+		void set_placementID(seq_id_t nodeID, int count);
 		std::vector<Node*> bfs_iterator_recurse(Node* currentNode);
 		std::vector<Node*> dfs_iterator_recurse(Node* currentNode);
 		std::vector<Node*> leave_iterator_recurse(Node* currentNode);
 		int get_newick_str_recurse(std::stringstream &outputTreeStream, Node *node, int count, bool write_edge_nums);
 
 	public:
-		Tree(std::string filename);
+		// Nodes are registered in registry, which must already contain the references.
+		// Placement mode, branch lengths and JPlace metadata are taken from params.
+		Tree(std::string filename, SequenceRegistry &registry, const Parameters &params);
 
 		bool write_newick(std::string filename);
 		std::vector<Node*> dfs_iterator;
@@ -51,6 +66,9 @@ class Tree {
 		seq_id_t get_LCA_best_count(countMap_t::iterator &it);
 		seq_id_t get_LCA_best_score(scoringMap_t::iterator &it);
 		seq_id_t get_LCA_best_count_exp(countMap_t::iterator &it, double div);
+		seq_id_t get_least_squares_placement(scoringMap_t::iterator &it, double &distal_length, double &pendant_length);
+		std::vector<std::pair<seq_id_t, double>> get_weighted_placements(seq_id_t placementID, scoringMap_t::iterator &scoringMap_it,
+				countMap_t::iterator &countMap_it, uint32_t n);
 
 		// Helper functions for assignment mode methods
 		void fill_internals_min_score();
@@ -74,10 +92,12 @@ class Tree {
 		bool is_child_of(seq_id_t child_id, seq_id_t parent_id);
 
 		// JPlace writing
-		void write_jplace_data_beginning();
-		void write_jplace_data_end();
-		void write_jplace_placement_data(std::vector<std::pair<seq_id_t, int>> &readAssignment, scoringMap_t &scoringMap);
-		void write_multiple_jplace(std::vector<std::pair<seq_id_t, double>> placements, bool first, seq_id_t seqID);
+		void write_jplace_data_beginning(PlacementWriter &writer);
+		void write_jplace_data_end(PlacementWriter &writer);
+		std::vector<PlacementRecord> get_placement_records(const std::pair<seq_id_t, int> &read, scoringMap_t &scoringMap,
+				branchLengthMap_t &branchLengths, placementMap_t &weightedPlacements);
+		std::vector<PlacementRecord> get_multiple_placement_records(std::vector<std::pair<seq_id_t, double>> &placements,
+				seq_id_t seqID, scoringMap_t &scoringMap);
 		std::string get_newick_str(bool write_edge_nums);
 
 		void fix_internalNodeNumbers();
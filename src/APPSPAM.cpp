@@ -22,7 +22,9 @@
 #include "Algorithms.h"
 #include "Scoring.h"
 #include "GlobalParameters.h"
-#include "Placement.h"
+#include "PlacementEngine.h"
+#include "ReferenceIndex.h"
+#include "PlacementServer.h"
 #include <omp.h>
 
 int main(int argc, char *argv[]) {
@@ -31,6 +33,13 @@ int main(int argc, char *argv[]) {
 	std::cout << "           based on spaced word matches         " << std::endl;
 	std::cout << "------------------------------------------------" << std::endl << std::endl;
 
+	if (argc > 1 and std::string(argv[1]) == "index") {
+		return ReferenceIndex::index_command(argc - 1, argv + 1);
+	}
+	if (argc > 1 and std::string(argv[1]) == "serve") {
+		return PlacementServer::serve_command(argc - 1, argv + 1);
+	}
+
 	// Parse command line options and check for correctness
 	GlobalParameters::parse_parameters(argc,  argv);
 	GlobalParameters::check_parameters();
@@ -39,9 +48,10 @@ int main(int argc, char *argv[]) {
 	omp_set_dynamic(0);
 	omp_set_num_threads(fswm_params::g_threads);
 
-	Placement::phylogenetic_placement();
+	PlacementEngine placementEngine(GlobalParameters::get_parameters());
+	placementEngine.place_file(fswm_params::g_readsfname);
 
-	if (fswm_params::g_writeParameter) { GlobalParameters::save_parameters(); };
+	if (fswm_params::g_writeParameter) { GlobalParameters::save_parameters(placementEngine.get_parameters()); };
 
 	std::cout << std::endl << "-> Placement finished. Output files are in the folder: "
 			  << fswm_params::g_outfoldername << std::endl;
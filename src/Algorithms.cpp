@@ -14,105 +14,508 @@
  * mail  : matthias.blanke@biologie.uni-goettingen.de
  */
 
+#include <omp.h>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <algorithm>
 #include "Algorithms.h"
 #include "Scoring.h"
 #include "SubstitutionMatrix.h"
 #include "Match.h"
 #include "MatchManager.h"
+#include "Profiler.h"
+
+typedef std::vector<std::pair<uint,uint>>::const_iterator wordGroup_it_t;
+
+// Groups are skipped by galloping when one side has at least this many times more groups than the other
+static const size_t gallopRatio = 8;
+
+// Matches of a read word added to the scores at once, and read groups probed at once
+static const size_t matchBatchSize = 32;
+static const size_t probeBatchSize = 16;
+
+// The group index of a genome bucket is probed when it has at least this many times more groups than the reads.
+// Below, galloping over the sorted groups is as fast, as it reads them in order.
+static const size_t probeRatio = 2048;
 
 /**
- * Calculate fswm distance between reads and genomes considering all spaced words.
+ * First group in [wordGroup_it, wordGroupEnd) whose matches are not smaller than those of word, given that the
+ * group at wordGroup_it is smaller. The step is doubled until a group is not smaller, so skipping n groups
+ * takes O(log n) comparisons.
+ */
+static wordGroup_it_t gallop_wordGroups(const Word *words, wordGroup_it_t wordGroup_it, wordGroup_it_t wordGroupEnd,
+		const Word &word) {
+	size_t step = 1;
+	while (step < (size_t) (wordGroupEnd - wordGroup_it) and words[wordGroup_it[step].first] < word) {
+		wordGroup_it += step;
+		step *= 2;
+	}
+	return std::lower_bound(wordGroup_it + 1, wordGroup_it + std::min(step, (size_t) (wordGroupEnd - wordGroup_it)), word,
+			[words](const std::pair<uint,uint> &group, const Word &other) { return words[group.first] < other; });
+}
+
+/**
+ * Advance the side of a merge whose group is smaller, by galloping if that side is much larger.
+ */
+static inline void advance_wordGroups(const Word *words, wordGroup_it_t &wordGroup_it, wordGroup_it_t wordGroupEnd,
+		const Word &word, bool gallop) {
+	if (gallop) {
+		wordGroup_it = gallop_wordGroups(words, wordGroup_it, wordGroupEnd, word);
+	}
+	else {
+		wordGroup_it++;
+	}
+}
+
+/**
+ * Every genomeStride-th genome word is compared with a read word of a group pair with more than
+ * params.maxGroupPairs pairs, or none if large groups are skipped. 1 compares all.
+ */
+static uint64_t genome_stride(uint readWords, uint genomeWords, const Parameters &params) {
+	uint64_t pairs = (uint64_t) readWords * genomeWords;
+	if (params.maxGroupPairs == 0 or pairs <= params.maxGroupPairs) {
+		return 1;
+	}
+	if (params.largeGroups == "skip") {
+		return 0;
+	}
+	return (pairs + params.maxGroupPairs - 1) / params.maxGroupPairs;
+}
+
+/** Approximate number of word pairs compared for a read and a genome group. */
+static uint64_t compared_pairs(uint readWords, uint genomeWords, const Parameters &params) {
+	uint64_t stride = genome_stride(readWords, genomeWords, params);
+	return stride == 0 ? 1 : (uint64_t) readWords * genomeWords / stride;
+}
+
+/**
+ * Score all pairs of words of a genome and a read word group with equal matches. Matches of a
+ * read word are collected in small batches and added together, so the maps of the read are looked
+ * up once per batch instead of for every match.
+ *
+ * Repeats make groups with thousands of words on both sides. With --max-group-pairs, read words of
+ * such groups are compared with every stride-th genome word only, starting at different offsets, so
+ * the compared pairs are spread evenly over all pairs of the groups.
  */
-bool Algorithms::fswm_complete(BucketManager &genomeBucketManager, BucketManager &readBucketManager, Scoring &fswm_distances) {
-	SubstitutionMatrix substMat;
-	std::ofstream histogramFile;
-	if (fswm_params::g_writeHistogram) { histogramFile.open(fswm_params::g_outfoldername + "histogram.txt", std::ios_base::app); }
+template <class Scores>
+static inline void join_wordGroup(const Word *wordsGenomes, const std::pair<uint,uint> &wordGroupGenome,
+		const Word *wordsReads, const std::pair<uint,uint> &wordGroupRead, Scores &scores,
+		ScoreHistogram *histogram, uint64_t &candidatePairs, uint64_t &count, const Parameters &params) {
+	static const SubstitutionMatrix substMat;
+	WordMatch wordMatches[matchBatchSize];
+	const int spaces = params.spaces;
+	const int filteringThreshold = params.filteringThreshold;
+
+	uint64_t genomeStride = genome_stride(wordGroupRead.second, wordGroupGenome.second, params);
+	uint64_t comparedPairs = (uint64_t) wordGroupRead.second * wordGroupGenome.second;
+	if (genomeStride != 1) {
+		uint64_t pairs = comparedPairs;
+		comparedPairs = 0;
+		for (uint readCounter = 0; genomeStride > 0 and readCounter < wordGroupRead.second; readCounter++) {
+			uint64_t offset = readCounter % genomeStride;
+			comparedPairs += offset < wordGroupGenome.second ? (wordGroupGenome.second - offset + genomeStride - 1) / genomeStride : 0;
+		}
+		Profiler::add_count(Profiler::LARGE_GROUPS, 1);
+		Profiler::add_count(Profiler::SKIPPED_PAIRS, pairs - comparedPairs);
+		if (genomeStride == 0) {
+			return;
+		}
+	}
 
+	// Loop through words with same spaced k-mer
+	candidatePairs += comparedPairs;
+	for (uint readCounter = 0; readCounter < wordGroupRead.second; readCounter++) {
+		const Word &wordRead = wordsReads[wordGroupRead.first + readCounter];
+		size_t batchSize = 0;
+		for (uint64_t genomeCounter = readCounter % genomeStride; genomeCounter < wordGroupGenome.second; genomeCounter += genomeStride) {
+			const Word &wordGenome = wordsGenomes[wordGroupGenome.first + genomeCounter];
+
+			// For each match calculate spaced word score
+			word_t dontCaresGenome = wordGenome.dontCares;
+			word_t dontCaresRead = wordRead.dontCares;
+
+			int score = 0;
+			int mismatches = 0;
+
+			for (int i = 0; i < spaces; i++) {
+				score += substMat.chiaromonte[(dontCaresGenome & 0x03)][(dontCaresRead & 0x03)];
+				mismatches += substMat.mismatch[(dontCaresGenome & 0x03)][(dontCaresRead & 0x03)];
+				dontCaresRead = dontCaresRead >> 2;
+				dontCaresGenome = dontCaresGenome >> 2;
+			}
+
+			if (histogram != nullptr) {
+				histogram->add(score, wordRead.seqID, wordGenome.seqID);
+			}
+
+			if (score > filteringThreshold) {
+				wordMatches[batchSize++] = {wordGenome.seqID, score, mismatches};
+				if (batchSize == matchBatchSize) {
+					scores.add_matches(wordRead.seqID, wordMatches, batchSize);
+					count += batchSize;
+					batchSize = 0;
+				}
+			}
+		}
+		if (batchSize > 0) {
+			scores.add_matches(wordRead.seqID, wordMatches, batchSize);
+			count += batchSize;
+		}
+	}
+}
+
+/**
+ * Merge join of genome and read word groups, both sorted by matches, that scores all pairs of words
+ * of groups with equal matches. wordRead_it is advanced, so genome groups can be joined in several calls.
+ * Matches are added to a Scoring or a PartialScoring. If one side has far more groups (e.g. a small
+ * partition against large references), it is galloped over, so the join takes time about proportional
+ * to the smaller side.
+ */
+template <class Scores>
+static void join_wordGroups(const Word *wordsGenomes, wordGroup_it_t wordGenome_it, wordGroup_it_t wordGenomeEnd,
+		const Word *wordsReads, wordGroup_it_t &wordRead_it, wordGroup_it_t wordReadEnd, Scores &scores,
+		ScoreHistogram *histogram, uint64_t &candidatePairs, uint64_t &count, const Parameters &params) {
+	size_t genomeGroups = wordGenomeEnd - wordGenome_it;
+	size_t readGroups = wordReadEnd - wordRead_it;
+	bool gallopGenomes = genomeGroups >= gallopRatio * readGroups;
+	bool gallopReads = readGroups >= gallopRatio * genomeGroups;
+
+	// Loop through all word groups
+	while (wordRead_it != wordReadEnd and wordGenome_it != wordGenomeEnd) {
+		if (wordsGenomes[wordGenome_it->first] < wordsReads[wordRead_it->first]) {
+			advance_wordGroups(wordsGenomes, wordGenome_it, wordGenomeEnd, wordsReads[wordRead_it->first], gallopGenomes);
+		}
+		else if (wordsGenomes[wordGenome_it->first] > wordsReads[wordRead_it->first]) {
+			advance_wordGroups(wordsReads, wordRead_it, wordReadEnd, wordsGenomes[wordGenome_it->first], gallopReads);
+		}
+		else {
+			join_wordGroup(wordsGenomes, *wordGenome_it, wordsReads, *wordRead_it, scores, histogram, candidatePairs, count, params);
+			wordGenome_it++;
+			wordRead_it++;
+		}
+	}
+}
+
+/**
+ * Join read word groups with a genome bucket by looking up every read group in the group index of
+ * the bucket, in time proportional to the read groups. Read groups are taken in order, so matches are
+ * added in the same order as by the merge join. Lookups are done in batches with prefetching, so the
+ * cache misses of the lookups in a batch overlap.
+ */
+template <class Scores>
+static void probe_wordGroups(Bucket &bucketGenomes, const Word *wordsReads, wordGroup_it_t wordRead_it,
+		wordGroup_it_t wordReadEnd, Scores &scores, ScoreHistogram *histogram, uint64_t &candidatePairs, uint64_t &count,
+		const Parameters &params) {
+	const Word *wordsGenomes = bucketGenomes.get_words().data();
+	std::vector<std::pair<uint,uint>> &wordGroupGenomes = bucketGenomes.get_wordGroups();
+
+	int64_t genomeGroups[probeBatchSize];
+	while (wordRead_it != wordReadEnd) {
+		size_t batchSize = std::min(probeBatchSize, (size_t) (wordReadEnd - wordRead_it));
+
+		// Slots of all lookups are loaded before the first one is needed, then the words of found groups
+		for (size_t i = 0; i < batchSize; i++) {
+			bucketGenomes.prefetch_wordGroup(wordsReads[wordRead_it[i].first].matches);
+		}
+		for (size_t i = 0; i < batchSize; i++) {
+			genomeGroups[i] = bucketGenomes.find_wordGroup(wordsReads[wordRead_it[i].first].matches);
+			if (genomeGroups[i] >= 0) {
+				__builtin_prefetch(&wordsGenomes[wordGroupGenomes[genomeGroups[i]].first]);
+			}
+		}
+
+		for (size_t i = 0; i < batchSize; i++, wordRead_it++) {
+			if (genomeGroups[i] >= 0) {
+				join_wordGroup(wordsGenomes, wordGroupGenomes[genomeGroups[i]], wordsReads, *wordRead_it, scores, histogram,
+						candidatePairs, count, params);
+			}
+		}
+	}
+}
+
+/**
+ * Probing pays off over the (galloping) merge join when there are far more genome than read groups,
+ * as for small partitions against large references.
+ */
+static bool probe_bucket(Bucket &bucketGenomes, size_t readGroups) {
+	return bucketGenomes.has_groupIndex() and bucketGenomes.get_wordGroups().size() >= probeRatio * readGroups;
+}
+
+/**
+ * Calculate fswm distance between reads and genomes considering all spaced words.
+ */
+bool Algorithms::fswm_complete(BucketManager &genomeBucketManager, BucketManager &readBucketManager, Scoring &fswm_distances,
+		const Parameters &params, ScoreHistogram *histogram) {
 	// Loop through minimizers and compare each bucket on its own
 	for (auto const minimizer : genomeBucketManager.get_minimizers()) {
-		//Get buckets
-		Bucket bucketGenomes = genomeBucketManager.get_bucket(minimizer);
-		Bucket bucketReads = readBucketManager.get_bucket(minimizer);
+		ProfilerTimer timer(Profiler::BUCKET_JOIN);
+		uint64_t candidatePairs = 0;
 
-		// Loop through buckets and compare spaced words
-		std::vector<Word> wordsGenomes = bucketGenomes.get_words();
-		std::vector<Word> wordsReads = bucketReads.get_words();
+		//Get buckets, genome buckets are shared by all partitions and only read
+		Bucket &bucketGenomes = genomeBucketManager.get_bucket(minimizer);
+		Bucket &bucketReads = readBucketManager.get_bucket(minimizer);
 
 		// Get vector of word groups. First int is starting position, second int length of group
-		std::vector<std::pair<uint,uint>> wordGroupGenomes = bucketGenomes.get_wordGroups();
-		std::vector<std::pair<uint,uint>> wordGroupReads = bucketReads.get_wordGroups();
-
-		std::vector<std::pair<uint,uint>>::const_iterator wordGenome_it = wordGroupGenomes.cbegin();
+		std::vector<std::pair<uint,uint>> &wordGroupReads = bucketReads.get_wordGroups();
 		std::vector<std::pair<uint,uint>>::const_iterator wordRead_it = wordGroupReads.cbegin();
 
-		if (fswm_params::g_verbose) {
+		if (params.verbose) {
 			std::cout << "\tBucket: " << bucketGenomes.get_minimizer() << std::endl;
 			std::cout << "\t\tBucket size genomes: " << bucketGenomes.get_bucketSize() << std::endl;
 			std::cout << "\t\tBucket size reads: " << bucketReads.get_bucketSize() << std::endl;
 		}
 
-		word_t dontCaresGenome;
-		word_t dontCaresRead;
-		int count = 0;
-		// Loop through all word groups
-		while (wordRead_it != wordGroupReads.end() and wordGenome_it != wordGroupGenomes.end()) {
+		uint64_t count = 0;
+		if (probe_bucket(bucketGenomes, wordGroupReads.size())) {
+			probe_wordGroups(bucketGenomes, bucketReads.get_words().data(), wordRead_it, wordGroupReads.cend(), fswm_distances,
+					histogram, candidatePairs, count, params);
+		}
+		else {
+			join_wordGroups(bucketGenomes.get_words().data(), bucketGenomes.get_wordGroups().cbegin(), bucketGenomes.get_wordGroups().cend(),
+					bucketReads.get_words().data(), wordRead_it, wordGroupReads.cend(), fswm_distances, histogram, candidatePairs, count,
+					params);
+		}
+
+		if (params.verbose) { std::cout << "\t\t# matches: " << count << std::endl; }
+		Profiler::add_count(Profiler::CANDIDATE_PAIRS, candidatePairs);
+		Profiler::add_count(Profiler::FILTERED_MATCHES, count);
+		Profiler::add_bucket_words(minimizer, bucketGenomes.get_bucketSize(), bucketReads.get_bucketSize());
+
+		// Partial reduction bounds the number of references per read while matching
+		fswm_distances.retain_top_references(params.topReferences, 8 * params.topReferences);
+	}
+
+	fswm_distances.retain_top_references(params.topReferences, params.topReferences);
+
+	return true;
+}
+
+/**
+ * The number of compared word pairs of a read word group is the size of the group
+ * times the size of the genome group with the same matches, which a merge of the
+ * group starts gives without comparing any don't care positions.
+ */
+std::vector<JoinUnit> Algorithms::plan_join_units(BucketManager &genomeBucketManager, BucketManager &readBucketManager,
+		uint32_t units, const Parameters &params) {
+	std::vector<minimizer_t> minimizers = genomeBucketManager.get_minimizers();
+	std::vector<std::vector<uint64_t>> groupPairs(minimizers.size());
+	uint64_t totalPairs = 0;
+
+	for (size_t m = 0; m < minimizers.size(); m++) {
+		Bucket &bucketGenomes = genomeBucketManager.get_bucket(minimizers[m]);
+		Bucket &bucketReads = readBucketManager.get_bucket(minimizers[m]);
+		const Word *wordsGenomes = bucketGenomes.get_words().data();
+		const Word *wordsReads = bucketReads.get_words().data();
+		std::vector<std::pair<uint,uint>> &wordGroupGenomes = bucketGenomes.get_wordGroups();
+		std::vector<std::pair<uint,uint>> &wordGroupReads = bucketReads.get_wordGroups();
+
+		groupPairs[m].assign(wordGroupReads.size(), 0);
+		if (probe_bucket(bucketGenomes, wordGroupReads.size())) {
+			for (size_t r = 0; r < wordGroupReads.size(); r++) {
+				int64_t g = bucketGenomes.find_wordGroup(wordsReads[wordGroupReads[r].first].matches);
+				if (g >= 0) {
+					groupPairs[m][r] = compared_pairs(wordGroupReads[r].second, wordGroupGenomes[g].second, params);
+					totalPairs += groupPairs[m][r];
+				}
+			}
+			continue;
+		}
+
+		bool gallopGenomes = wordGroupGenomes.size() >= gallopRatio * wordGroupReads.size();
+		bool gallopReads = wordGroupReads.size() >= gallopRatio * wordGroupGenomes.size();
+		wordGroup_it_t wordGenome_it = wordGroupGenomes.cbegin();
+		wordGroup_it_t wordRead_it = wordGroupReads.cbegin();
+		while (wordRead_it != wordGroupReads.cend() and wordGenome_it != wordGroupGenomes.cend()) {
 			if (wordsGenomes[wordGenome_it->first] < wordsReads[wordRead_it->first]) {
-				wordGenome_it++;
+				advance_wordGroups(wordsGenomes, wordGenome_it, wordGroupGenomes.cend(), wordsReads[wordRead_it->first], gallopGenomes);
 			}
 			else if (wordsGenomes[wordGenome_it->first] > wordsReads[wordRead_it->first]) {
-				wordRead_it++;
+				advance_wordGroups(wordsReads, wordRead_it, wordGroupReads.cend(), wordsGenomes[wordGenome_it->first], gallopReads);
 			}
 			else {
-				// Loop through words with same spaced k-mer
-				for (int readCounter = 0; readCounter < wordRead_it->second; readCounter++) {
-					for (int genomeCounter = 0; genomeCounter < wordGenome_it->second; genomeCounter++) {
-
-						// For each match calculate spaced word score
-						dontCaresGenome = wordsGenomes[wordGenome_it->first + genomeCounter].dontCares;
-						dontCaresRead = wordsReads[wordRead_it->first + readCounter].dontCares;
-
-						int score = 0;
-						int mismatches = 0;
-
-						for (int i = 0; i < fswm_params::g_spaces; i++) {
-							score += substMat.chiaromonte[(dontCaresGenome & 0x03)][(dontCaresRead & 0x03)];
-							mismatches += substMat.mismatch[(dontCaresGenome & 0x03)][(dontCaresRead & 0x03)];
-							dontCaresRead = dontCaresRead >> 2;
-							dontCaresGenome = dontCaresGenome >> 2;
-						}
-
-						if (fswm_params::g_writeHistogram) {
-							int readSeqID = wordsReads[wordRead_it->first + readCounter].seqID;
-							int genomeSeqID = wordsGenomes[wordGenome_it->first + genomeCounter].seqID;
-							histogramFile << readSeqID << "\t" << genomeSeqID << "\t" << score << std::endl;
-						}
-
-						if (score > fswm_params::g_filteringThreshold) {
-							count++;
-							int readSeqID = wordsReads[wordRead_it->first + readCounter].seqID;
-							int genomeSeqID = wordsGenomes[wordGenome_it->first + genomeCounter].seqID;
-							// std::cout << readSeqID << "\t" << genomeSeqID << "\t" << wordsReads[wordRead_it->first + readCounter].seqPos << std::endl;
-							if (fswm_distances.scoringMap.find(readSeqID) == fswm_distances.scoringMap.end()) {
-								fswm_distances.scoringMap[readSeqID] = std::unordered_map<seq_id_t, scoring_t>();
-								fswm_distances.mismatchCount[readSeqID] = std::unordered_map<seq_id_t, count_t>();
-								fswm_distances.spacedWordMatchCount[readSeqID] = std::unordered_map<seq_id_t, count_t>();
-							}
-							fswm_distances.scoringMap[readSeqID][genomeSeqID] += score;
-							fswm_distances.mismatchCount[readSeqID][genomeSeqID] += mismatches;
-							fswm_distances.spacedWordMatchCount[readSeqID][genomeSeqID] += 1;
-						}
-					}
-				}
+				size_t r = wordRead_it - wordGroupReads.cbegin();
+				groupPairs[m][r] = compared_pairs(wordRead_it->second, wordGenome_it->second, params);
+				totalPairs += groupPairs[m][r];
 				wordGenome_it++;
 				wordRead_it++;
 			}
 		}
-		if (fswm_params::g_verbose) { std::cout << "\t\t# matches: " << count << std::endl; }
 	}
 
-	if (fswm_params::g_writeHistogram) { histogramFile.close(); }
+	// Cut the read word groups of every bucket into units of about totalPairs / units pairs
+	uint64_t unitPairs = std::max(totalPairs / std::max(units, (uint32_t) 1), (uint64_t) 1);
+	std::vector<JoinUnit> joinUnits;
+	for (size_t m = 0; m < minimizers.size(); m++) {
+		JoinUnit unit = {minimizers[m], 0, 0, 0};
+		for (uint r = 0; r < groupPairs[m].size(); r++) {
+			unit.candidatePairs += groupPairs[m][r];
+			unit.lastGroup = r + 1;
+			if (unit.candidatePairs >= unitPairs) {
+				joinUnits.push_back(unit);
+				unit = {minimizers[m], r + 1, r + 1, 0};
+			}
+		}
+		if (unit.candidatePairs > 0) {
+			joinUnits.push_back(unit);
+		}
+	}
+	return joinUnits;
+}
+
+void Algorithms::join_unit(BucketManager &genomeBucketManager, BucketManager &readBucketManager, const JoinUnit &unit,
+		PartialScoring &partialScoring, ScoreHistogram *histogram, uint64_t &candidatePairs, uint64_t &count, const Parameters &params) {
+	ProfilerTimer timer(Profiler::BUCKET_JOIN);
+	Bucket &bucketGenomes = genomeBucketManager.get_bucket(unit.minimizer);
+	Bucket &bucketReads = readBucketManager.get_bucket(unit.minimizer);
+	const Word *wordsGenomes = bucketGenomes.get_words().data();
+	const Word *wordsReads = bucketReads.get_words().data();
+	std::vector<std::pair<uint,uint>> &wordGroupGenomes = bucketGenomes.get_wordGroups();
+	std::vector<std::pair<uint,uint>> &wordGroupReads = bucketReads.get_wordGroups();
+
+	wordGroup_it_t wordRead_it = wordGroupReads.cbegin() + unit.firstGroup;
+	if (probe_bucket(bucketGenomes, unit.lastGroup - unit.firstGroup)) {
+		probe_wordGroups(bucketGenomes, wordsReads, wordRead_it, wordGroupReads.cbegin() + unit.lastGroup, partialScoring,
+				histogram, candidatePairs, count, params);
+		return;
+	}
+
+	const Word &firstWord = wordsReads[wordRead_it->first];
+	wordGroup_it_t wordGenome_it = std::lower_bound(wordGroupGenomes.cbegin(), wordGroupGenomes.cend(), firstWord,
+			[wordsGenomes](const std::pair<uint,uint> &group, const Word &word) { return wordsGenomes[group.first] < word; });
+
+	join_wordGroups(wordsGenomes, wordGenome_it, wordGroupGenomes.cend(), wordsReads, wordRead_it,
+			wordGroupReads.cbegin() + unit.lastGroup, partialScoring, histogram, candidatePairs, count, params);
+}
+
+/**
+ * Units are created as tasks with the largest ones first, so threads of the
+ * enclosing parallel region that are done with their own partitions help with
+ * this one. Results are added in the order of the sequential join and the
+ * partial reduction runs after every bucket as there.
+ */
+bool Algorithms::fswm_complete_tasks(GenomeManager &genomeManager, BucketManager &readBucketManager, Scoring &fswm_distances,
+		const Parameters &params, ScoreHistogram *histogram) {
+	BucketManager &genomeBucketManager = genomeManager.get_BucketManager();
+	if (omp_get_num_threads() == 1) {
+		return fswm_complete(genomeBucketManager, readBucketManager, fswm_distances, params, histogram);
+	}
+
+	std::vector<JoinUnit> joinUnits = plan_join_units(genomeBucketManager, readBucketManager, 4 * omp_get_num_threads(), params);
+
+	std::vector<size_t> order(joinUnits.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(),
+			[&joinUnits](size_t a, size_t b) { return joinUnits[a].candidatePairs > joinUnits[b].candidatePairs; });
+
+	std::vector<PartialScoring> partialScorings(joinUnits.size());
+	std::vector<std::unique_ptr<ScoreHistogram>> histograms(joinUnits.size());
+	std::vector<uint64_t> candidatePairs(joinUnits.size(), 0);
+	std::vector<uint64_t> counts(joinUnits.size(), 0);
+	for (size_t i : order) {
+		if (histogram != nullptr) {
+			histograms[i].reset(new ScoreHistogram(params));
+		}
+		#pragma omp task default(shared) firstprivate(i)
+		join_unit(genomeManager.get_BucketManager(), readBucketManager, joinUnits[i], partialScorings[i], histograms[i].get(),
+				candidatePairs[i], counts[i], params);
+	}
+	#pragma omp taskwait
+
+	size_t unit = 0;
+	for (auto const minimizer : genomeBucketManager.get_minimizers()) {
+		uint64_t bucketPairs = 0;
+		uint64_t count = 0;
+		for (; unit < joinUnits.size() and joinUnits[unit].minimizer == minimizer; unit++) {
+			fswm_distances.add_partial(partialScorings[unit]);
+			partialScorings[unit] = PartialScoring();
+			if (histogram != nullptr) {
+				histogram->merge(*histograms[unit]);
+			}
+			bucketPairs += candidatePairs[unit];
+			count += counts[unit];
+		}
+
+		Bucket &bucketGenomes = genomeBucketManager.get_bucket(minimizer);
+		Bucket &bucketReads = readBucketManager.get_bucket(minimizer);
+		if (params.verbose) {
+			std::cout << "\tBucket: " << minimizer << std::endl;
+			std::cout << "\t\tBucket size genomes: " << bucketGenomes.get_bucketSize() << std::endl;
+			std::cout << "\t\tBucket size reads: " << bucketReads.get_bucketSize() << std::endl;
+			std::cout << "\t\t# matches: " << count << std::endl;
+		}
+		Profiler::add_count(Profiler::CANDIDATE_PAIRS, bucketPairs);
+		Profiler::add_count(Profiler::FILTERED_MATCHES, count);
+		Profiler::add_bucket_words(minimizer, bucketGenomes.get_bucketSize(), bucketReads.get_bucketSize());
+
+		fswm_distances.retain_top_references(params.topReferences, 8 * params.topReferences);
+	}
+
+	fswm_distances.retain_top_references(params.topReferences, params.topReferences);
+
+	return true;
+}
+
+/**
+ * Genome words are read in blocks that end at the start of a word group, so every
+ * word group is joined as a whole.
+ */
+bool Algorithms::fswm_complete(ExternalBuckets &genomeBuckets, BucketManager &readBucketManager, Scoring &fswm_distances,
+		const Parameters &params, ScoreHistogram *histogram) {
+	std::vector<Word> block;
+	std::vector<std::pair<uint,uint>> wordGroupGenomes;
+
+	for (auto const minimizer : readBucketManager.get_minimizers()) {
+		ProfilerTimer timer(Profiler::BUCKET_JOIN);
+		uint64_t candidatePairs = 0;
+		uint64_t count = 0;
+
+		Bucket &bucketReads = readBucketManager.get_bucket(minimizer);
+		std::vector<std::pair<uint,uint>> &wordGroupReads = bucketReads.get_wordGroups();
+		std::vector<std::pair<uint,uint>>::const_iterator wordRead_it = wordGroupReads.cbegin();
+
+		if (params.verbose) {
+			std::cout << "\tBucket: " << minimizer << " (streamed)" << std::endl;
+			std::cout << "\t\tBucket size genomes: " << genomeBuckets.get_bucketSize(minimizer) << std::endl;
+			std::cout << "\t\tBucket size reads: " << bucketReads.get_bucketSize() << std::endl;
+		}
+
+		std::ifstream bucketStream(genomeBuckets.get_bucket_filename(minimizer), std::ios::binary);
+		block.clear();
+		bool complete = false;
+		while (!complete and wordRead_it != wordGroupReads.cend()) {
+			complete = !genomeBuckets.read_block(bucketStream, block);
+
+			// Groups of the block, the last one is carried over to the next block unless the bucket ends here
+			wordGroupGenomes.clear();
+			uint groupStart = 0;
+			for (uint idx = 1; idx < block.size(); idx++) {
+				if (block[idx].matches != block[groupStart].matches) {
+					wordGroupGenomes.push_back(std::pair<uint,uint> (groupStart, idx - groupStart));
+					groupStart = idx;
+				}
+			}
+			if (complete and groupStart < block.size()) {
+				wordGroupGenomes.push_back(std::pair<uint,uint> (groupStart, block.size() - groupStart));
+				groupStart = block.size();
+			}
+
+			join_wordGroups(block.data(), wordGroupGenomes.cbegin(), wordGroupGenomes.cend(), bucketReads.get_words().data(),
+					wordRead_it, wordGroupReads.cend(), fswm_distances, histogram, candidatePairs, count, params);
+			block.erase(block.begin(), block.begin() + groupStart);
+		}
+
+		if (params.verbose) { std::cout << "\t\t# matches: " << count << std::endl; }
+		Profiler::add_count(Profiler::CANDIDATE_PAIRS, candidatePairs);
+		Profiler::add_count(Profiler::FILTERED_MATCHES, count);
+		Profiler::add_bucket_words(minimizer, genomeBuckets.get_bucketSize(minimizer), bucketReads.get_bucketSize());
+
+		fswm_distances.retain_top_references(params.topReferences, 8 * params.topReferences);
+	}
+
+	fswm_distances.retain_top_references(params.topReferences, params.topReferences);
 
 	return true;
 }
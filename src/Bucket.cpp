@@ -21,6 +21,7 @@
 Bucket::Bucket(minimizer_t minimizer) {
 	this->minimizer = minimizer;
 	bucketSize = 0;
+	groupIndexMask = 0;
 	words.reserve(10000);
 }
 
@@ -48,5 +49,31 @@ bool Bucket::create_wordGroups() {
 			currentMatchesHash = words[currentWord_idx].matches;
 		}
 	}
+	if (words.size() > 0) {
+		wordGroups.push_back(std::pair<uint,uint> (currentWord_idx, currentGroupSize));
+	}
+	return true;
+}
+
+/**
+ * The table has at least 1.5 times as many slots as there are word groups, so
+ * probes for matches that are not in the bucket end after few slots while the
+ * table takes at most 8 bytes per group.
+ */
+bool Bucket::create_groupIndex() {
+	uint64_t slots = 2;
+	while (slots < (uint64_t) wordGroups.size() + wordGroups.size() / 2) {
+		slots *= 2;
+	}
+	groupIndex.assign(slots, 0);
+	groupIndexMask = slots - 1;
+
+	for (uint32_t group = 0; group < wordGroups.size(); group++) {
+		uint64_t slot = hash_matches(words[wordGroups[group].first].matches) & groupIndexMask;
+		while (groupIndex[slot] != 0) {
+			slot = (slot + 1) & groupIndexMask;
+		}
+		groupIndex[slot] = group + 1;
+	}
 	return true;
 }
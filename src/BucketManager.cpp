@@ -41,6 +41,13 @@ bool BucketManager::create_wordGroups() {
 	return true;
 }
 
+bool BucketManager::create_groupIndexes() {
+	for (auto &minimizerToBucket : minimizersToBuckets) {
+		minimizerToBucket.second.create_groupIndex();
+	}
+	return true;
+}
+
 bool BucketManager::print_bucket_information() const {
 	for (auto & bucket: minimizersToBuckets) {
 		std::cout << bucket.first << ": " << bucket.second.get_bucketSize() << std::endl;
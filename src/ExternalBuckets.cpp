@@ -0,0 +1,278 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <queue>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unistd.h>
+#include <dirent.h>
+#include "ExternalBuckets.h"
+#include "Profiler.h"
+
+// Temporary folders of all existing objects, removed as well when the program exits early
+static std::mutex foldersMutex;
+static std::set<std::string> activeFolders;
+
+static void remove_folder(const std::string &foldername) {
+	DIR *dir = opendir(foldername.c_str());
+	if (dir != nullptr) {
+		while (struct dirent *entry = readdir(dir)) {
+			if (strcmp(entry->d_name, ".") != 0 and strcmp(entry->d_name, "..") != 0) {
+				unlink((foldername + "/" + entry->d_name).c_str());
+			}
+		}
+		closedir(dir);
+	}
+	rmdir(foldername.c_str());
+}
+
+static void remove_active_folders() {
+	std::lock_guard<std::mutex> lock(foldersMutex);
+	for (auto const &foldername : activeFolders) {
+		remove_folder(foldername);
+	}
+	activeFolders.clear();
+}
+
+// Written by the signal handler, read by the cleanup thread
+static int signalPipe[2] = {-1, -1};
+
+/**
+ * Removing folders is not async-signal-safe (allocation, readdir, the lock), so the
+ * handler only passes the signal number on to the cleanup thread.
+ */
+static void forward_signal(int signum) {
+	int savedErrno = errno;
+	char signalByte = (char) signum;
+	if (write(signalPipe[1], &signalByte, 1) != 1) {
+		signal(signum, SIG_DFL);
+		raise(signum);
+	}
+	errno = savedErrno;
+}
+
+/**
+ * Waits for a forwarded signal, removes the folders and raises the signal again with the
+ * default action. The lock is kept, so no object can remove or add a folder in between.
+ */
+static void remove_active_folders_on_signal() {
+	char signalByte;
+	ssize_t n;
+	do {
+		n = read(signalPipe[0], &signalByte, 1);
+	} while (n < 0 and errno == EINTR);
+	if (n != 1) {
+		return;
+	}
+	int signum = signalByte;
+	std::lock_guard<std::mutex> lock(foldersMutex);
+	for (auto const &foldername : activeFolders) {
+		remove_folder(foldername);
+	}
+	signal(signum, SIG_DFL);
+	raise(signum);
+}
+
+/** Handlers are only installed for signals without another handler (e.g. of the server). */
+static void install_cleanup_handlers() {
+	atexit(remove_active_folders);
+	if (pipe(signalPipe) != 0) {
+		return;		// Folders are still removed on a regular exit
+	}
+	std::thread(remove_active_folders_on_signal).detach();
+	for (int signum : {SIGINT, SIGTERM}) {
+		struct sigaction action;
+		sigaction(signum, nullptr, &action);
+		if (action.sa_handler == SIG_DFL) {
+			memset(&action, 0, sizeof(action));
+			action.sa_handler = forward_signal;
+			sigaction(signum, &action, nullptr);
+		}
+	}
+}
+
+ExternalBuckets::ExternalBuckets(std::string tmpfoldername, uint64_t blockWords, bool verbose) {
+	this->blockWords = std::max(blockWords, (uint64_t) 4096);
+	this->verbose = verbose;
+	this->runCount = 0;
+
+	if (tmpfoldername.empty()) {
+		tmpfoldername = "/tmp";
+	}
+	std::string folderTemplate = tmpfoldername + "/appspam_buckets_XXXXXX";
+	std::vector<char> folder(folderTemplate.begin(), folderTemplate.end());
+	folder.push_back('\0');
+	if (mkdtemp(folder.data()) == nullptr) {
+		std::cerr << "ERROR: Could not create temporary folder in " << tmpfoldername << "." << std::endl;
+		exit (EXIT_FAILURE);
+	}
+	foldername = folder.data();
+
+	static std::once_flag handlersInstalled;
+	std::call_once(handlersInstalled, install_cleanup_handlers);
+	std::lock_guard<std::mutex> lock(foldersMutex);
+	activeFolders.insert(foldername);
+}
+
+ExternalBuckets::~ExternalBuckets() {
+	std::lock_guard<std::mutex> lock(foldersMutex);
+	remove_folder(foldername);
+	activeFolders.erase(foldername);
+}
+
+/**
+ * Words are written as they are in memory, the files are only read by this process.
+ */
+void ExternalBuckets::spill(BucketManager &bucketManager) {
+	ProfilerTimer timer(Profiler::BUCKET_SPILL);
+	for (auto const minimizer : bucketManager.get_minimizers()) {
+		std::vector<Word> words;
+		bucketManager.set_words(minimizer, words);
+		if (words.empty()) {
+			continue;
+		}
+		std::sort(words.begin(), words.end(), Bucket::word_order);
+
+		std::string runfname = foldername + "/bucket" + std::to_string(minimizer) + "_run" + std::to_string(runCount) + ".bin";
+		std::ofstream runStream(runfname, std::ios::binary);
+		runStream.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(Word));
+		runStream.close();
+		if (!runStream.good()) {
+			std::cerr << "ERROR: Could not write temporary bucket file " << runfname << " (disk full?)." << std::endl;
+			exit (EXIT_FAILURE);
+		}
+		runfnames[minimizer].push_back(runfname);
+		bucketSizes[minimizer] += words.size();
+	}
+	runCount++;
+	if (verbose) { std::cout << "\tSpilled run " << runCount << " of reference words to " << foldername << std::endl; }
+}
+
+void ExternalBuckets::finish() {
+	ProfilerTimer timer(Profiler::BUCKET_SPILL);
+	for (minimizer_t minimizer = 0; minimizer < 16; minimizer++) {
+		if (!merge_runs(minimizer)) {
+			std::cerr << "ERROR: Could not write temporary bucket file " << get_bucket_filename(minimizer) << " (disk full?)." << std::endl;
+			exit (EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * K-way merge of the sorted runs of a bucket. Every run is read through a buffer,
+ * so only about blockWords words per bucket are in memory at any time.
+ */
+bool ExternalBuckets::merge_runs(minimizer_t minimizer) {
+	std::string bucketfname = get_bucket_filename(minimizer);
+	std::vector<std::string> &runs = runfnames[minimizer];
+
+	if (runs.size() <= 1) {
+		bool renamed = runs.empty() ? (bool) std::ofstream(bucketfname, std::ios::binary) : rename(runs[0].c_str(), bucketfname.c_str()) == 0;
+		runs.assign(1, bucketfname);
+		return renamed;
+	}
+
+	struct Run {
+		std::ifstream stream;
+		std::vector<Word> buffer;
+		size_t next;
+	};
+	uint64_t runWords = std::max(blockWords / runs.size(), (uint64_t) 1024);
+	std::vector<std::unique_ptr<Run>> readers;
+	for (auto const &runfname : runs) {
+		std::unique_ptr<Run> run(new Run());
+		run->stream.open(runfname, std::ios::binary);
+		run->next = 0;
+		readers.push_back(std::move(run));
+	}
+	auto refill = [&](Run &run) {
+		run.buffer.clear();
+		run.next = 0;
+		read_words(run.stream, run.buffer, runWords);
+	};
+
+	// Queue of the next word of every run, smallest word (by Bucket::word_order) on top
+	auto greater = [&](const std::pair<Word, size_t> &a, const std::pair<Word, size_t> &b) {
+		return Bucket::word_order(b.first, a.first);
+	};
+	std::priority_queue<std::pair<Word, size_t>, std::vector<std::pair<Word, size_t>>, decltype(greater)> queue(greater);
+	for (size_t i = 0; i < readers.size(); i++) {
+		refill(*readers[i]);
+		if (!readers[i]->buffer.empty()) {
+			queue.push(std::make_pair(readers[i]->buffer[readers[i]->next++], i));
+		}
+	}
+
+	std::ofstream bucketStream(bucketfname, std::ios::binary);
+	std::vector<Word> out;
+	out.reserve(blockWords);
+	while (!queue.empty()) {
+		std::pair<Word, size_t> top = queue.top();
+		queue.pop();
+		out.push_back(top.first);
+		if (out.size() == blockWords) {
+			bucketStream.write(reinterpret_cast<const char*>(out.data()), out.size() * sizeof(Word));
+			out.clear();
+		}
+
+		Run &run = *readers[top.second];
+		if (run.next == run.buffer.size()) {
+			refill(run);
+		}
+		if (run.next < run.buffer.size()) {
+			queue.push(std::make_pair(run.buffer[run.next++], top.second));
+		}
+	}
+	bucketStream.write(reinterpret_cast<const char*>(out.data()), out.size() * sizeof(Word));
+	bucketStream.close();
+
+	for (auto const &runfname : runs) {
+		unlink(runfname.c_str());
+	}
+	runs.assign(1, bucketfname);
+	return bucketStream.good();
+}
+
+bool ExternalBuckets::read_words(std::ifstream &wordStream, std::vector<Word> &words, uint64_t count) {
+	size_t oldSize = words.size();
+	words.resize(oldSize + count, Word(0, 0, 0, 0));
+	wordStream.read(reinterpret_cast<char*>(words.data() + oldSize), count * sizeof(Word));
+	size_t readWords = wordStream.gcount() / sizeof(Word);
+	words.resize(oldSize + readWords, Word(0, 0, 0, 0));
+	return readWords == count;
+}
+
+bool ExternalBuckets::read_block(std::ifstream &bucketStream, std::vector<Word> &block) const {
+	return read_words(bucketStream, block, blockWords);
+}
+
+std::string ExternalBuckets::get_bucket_filename(minimizer_t minimizer) const {
+	return foldername + "/bucket" + std::to_string(minimizer) + ".bin";
+}
+
+uint64_t ExternalBuckets::get_bucketSize(minimizer_t minimizer) const {
+	auto bucketSize = bucketSizes.find(minimizer);
+	return bucketSize == bucketSizes.end() ? 0 : bucketSize->second;
+}
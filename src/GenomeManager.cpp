@@ -15,40 +15,146 @@
  */
 
 #include <math.h>
+#include <thread>
+#include <sched.h>
 #include "GenomeManager.h"
 #include "Word.h"
 #include "SeqIO.h"
 #include "GlobalParameters.h"
+#include "Profiler.h"
+#include "NumaTopology.h"
 
-GenomeManager::GenomeManager(std::string genomesfname, std::vector<Seed> &seeds) {
-	if (fswm_params::g_verbose) { std::cout << "-> Reading genomes from file: " << genomesfname << std::endl; }
+GenomeManager::GenomeManager(std::string genomesfname, std::vector<Seed> &seeds, SequenceRegistry &registry,
+		const Parameters &params) {
+	if (params.verbose) { std::cout << "-> Reading genomes from file: " << genomesfname << std::endl; }
 
 	bucketManagerGenomes = BucketManager();
 
 	std::vector<Sequence> genomes;
-	SeqIO::read_sequences(genomesfname, genomes, true);
-	if (fswm_params::g_verbose) { std::cout << "\t" << fswm_internal::g_numberGenomes << " genomes found and read."<< std::endl; }
+	{
+		ProfilerTimer timer(Profiler::REFERENCE_PARSING);
+		SeqIO::read_sequences(genomesfname, genomes, true, registry, params);
+	}
+	if (params.verbose) { std::cout << "\t" << registry.get_genomes().size() << " genomes found and read."<< std::endl; }
 
 	this->genomeCount = genomes.size();
 
-	if (fswm_params::g_verbose) { std::cout << "\t" << "Creating spaced words for genomes." << std::endl; }
+	if (params.verbose) { std::cout << "\t" << "Creating spaced words for genomes." << std::endl; }
+	uint64_t spillWords = params.memoryLimit / 2 / sizeof(Word);
 	for (auto &genome : genomes) {
-		genome.fill_buckets(seeds, bucketManagerGenomes);
+		// Words of one pattern at a time, so that a single long reference never fills the memory
+		for (auto &seed : seeds) {
+			std::vector<Seed> singleSeed(1, seed);
+			{
+				ProfilerTimer timer(Profiler::FILL_BUCKETS);
+				genome.fill_buckets(singleSeed, bucketManagerGenomes, params);
+			}
+			if (spillWords > 0 and bucketManagerGenomes.get_wordCount() > spillWords) {
+				if (!externalBuckets) {
+					externalBuckets.reset(new ExternalBuckets(params.tmpfoldername,
+							params.memoryLimit / 8 / params.threads / sizeof(Word), params.verbose));
+				}
+				externalBuckets->spill(bucketManagerGenomes);
+			}
+		}
 	}
 
 	genomes.clear();
 	genomes.shrink_to_fit();
 
-	bucketManagerGenomes.create_wordGroups();
+	if (externalBuckets) {
+		externalBuckets->spill(bucketManagerGenomes);
+		externalBuckets->finish();
+		std::cout << "\tReference words exceed half of the memory limit, " << externalBuckets->get_runCount()
+				  << " sorted runs were spilled to disk." << std::endl;
+		return;
+	}
+
+	{
+		ProfilerTimer timer(Profiler::BUCKET_SORT_GROUP);
+		bucketManagerGenomes.create_wordGroups();
+		bucketManagerGenomes.create_groupIndexes();
+	}
+	distribute_numa(params);
+}
+
+GenomeManager::GenomeManager(ReferenceIndex &referenceIndex, SequenceRegistry &registry, const Parameters &params) {
+	this->genomeCount = referenceIndex.get_genomes().size();
+	if (params.verbose) { std::cout << "\t" << genomeCount << " genomes found in index."<< std::endl; }
+
+	bucketManagerGenomes = BucketManager();
+	referenceIndex.move_to_BucketManager(bucketManagerGenomes, registry);
+
+	{
+		ProfilerTimer timer(Profiler::BUCKET_SORT_GROUP);
+		bucketManagerGenomes.create_wordGroups();
+		bucketManagerGenomes.create_groupIndexes();
+	}
+	distribute_numa(params);
 }
 
 /**
- * Return BucketManager for the next partition of genomes from input sequences.
+ * Copies are made by threads pinned to their node, so the pages are placed
+ * there by first touch. With interleave a single copy is made with pages
+ * spread round robin over all nodes.
  */
-BucketManager GenomeManager::get_BucketManager() {
+void GenomeManager::distribute_numa(const Parameters &params) {
+	uint32_t nodes = NumaTopology::get_nodeCount();
+	if (params.numaMode == "off" or nodes < 2) {
+		Profiler::set_info("numa_nodes", std::to_string(nodes));
+		return;
+	}
+
+	ProfilerTimer timer(Profiler::NUMA_DISTRIBUTION);
+	if (params.numaMode == "interleave") {
+		NumaTopology::set_interleaved_allocation(true);
+		BucketManager interleaved = bucketManagerGenomes;
+		NumaTopology::set_interleaved_allocation(false);
+		bucketManagerGenomes = std::move(interleaved);
+	}
+	else {
+		// The original stays on the node it was created on
+		int cpu = sched_getcpu();
+		uint32_t homeNode = 0;
+		for (uint32_t node = 0; node < nodes; node++) {
+			for (int nodeCpu : NumaTopology::get_nodes()[node]) {
+				homeNode = nodeCpu == cpu ? node : homeNode;
+			}
+		}
+
+		replicas.resize(nodes);
+		std::vector<std::thread> copiers;
+		for (uint32_t node = 0; node < nodes; node++) {
+			if (node == homeNode) {
+				continue;
+			}
+			copiers.push_back(std::thread([this, node]() {
+				NumaTopology::pin_thread(node);
+				replicas[node].reset(new BucketManager(bucketManagerGenomes));
+			}));
+		}
+		for (auto &copier : copiers) {
+			copier.join();
+		}
+	}
+
+	if (params.verbose) { std::cout << "	Reference words placed on " << nodes << " NUMA nodes (" << params.numaMode << ")." << std::endl; }
+	Profiler::set_info("numa_nodes", std::to_string(nodes));
+	Profiler::set_info("numa_replicas", std::to_string(params.numaMode == "replicate" ? nodes : 1));
+}
+
+BucketManager& GenomeManager::get_BucketManager() {
+	uint32_t node = NumaTopology::get_current_node();
+	if (node < replicas.size() and replicas[node]) {
+		return *replicas[node];
+	}
 	return (bucketManagerGenomes);
 }
 
+ExternalBuckets* GenomeManager::get_ExternalBuckets() {
+	return externalBuckets.get();
+}
+
 std::vector<Sequence>& GenomeManager::get_genomes() {
 	return genomes;
 }
@@ -56,3 +162,14 @@ std::vector<Sequence>& GenomeManager::get_genomes() {
 uint32_t GenomeManager::get_genomeCount() const {
 	return genomeCount;
 }
+
+uint64_t GenomeManager::get_wordCount() {
+	if (externalBuckets) {
+		uint64_t wordCount = 0;
+		for (auto const minimizer : bucketManagerGenomes.get_minimizers()) {
+			wordCount += externalBuckets->get_bucketSize(minimizer);
+		}
+		return wordCount;
+	}
+	return bucketManagerGenomes.get_wordCount();
+}
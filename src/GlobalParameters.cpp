@@ -25,6 +25,9 @@
 #include <sys/stat.h>
 #include <sstream>
 #include "GlobalParameters.h"
+#include "Sequence.h"
+#include "SequenceRegistry.h"
+#include "NumaTopology.h"
 
 // Initialize global parameters to and set default values
 
@@ -35,6 +38,8 @@ std::string fswm_params::g_readsfname = "";
 std::string fswm_params::g_outjplacename = "appspam_placement_results.jplace";
 std::string fswm_params::g_outfoldername = "./";
 std::string fswm_params::g_paramfname = "";
+std::string fswm_params::g_indexfoldername = "";
+std::string fswm_params::g_outputFormat = "jplace";
 
 // General parameters
 uint16_t fswm_params::g_weight = 12;
@@ -51,43 +56,68 @@ std::string fswm_params::g_delimiter = "_";
 // Additional options
 uint16_t fswm_params::g_threads = 1;
 uint32_t fswm_params::g_readBlockSize = 10000;
+bool fswm_params::g_autoReadBlockSize = false;
+uint64_t fswm_params::g_memoryLimit = 0;
+std::string fswm_params::g_tmpfoldername = getenv("TMPDIR") != nullptr ? getenv("TMPDIR") : "/tmp";
+std::string fswm_params::g_numaMode = "off";
 bool fswm_params::g_writeHistogram = false;
+bool fswm_params::g_histogramPerPair = false;
 bool fswm_params::g_writeScoring = false;
+bool fswm_params::g_writeReport = false;
+std::string fswm_params::g_scoresFormat = "text";
 bool fswm_params::g_writeParameter = false;
 bool fswm_params::g_writeIDs = false;
 double fswm_params::default_distance_new_leaves = 0.001;
 int fswm_params::g_numPatterns = 1;
+uint32_t fswm_params::g_patternSeed = 0;
+std::string fswm_params::g_patternfname = "";
+std::string fswm_params::g_patternCache = GlobalParameters::default_patternCache();
 double fswm_params::g_defaultDistance = 10;
 double fswm_params::g_spam_X = 4;
-
-// Initialize global internal mappings between sequence IDs and names.
-std::unordered_map<seq_id_t, std::string> fswm_internal::seqIDsToNames = std::unordered_map<seq_id_t, std::string>();
-std::unordered_map<std::string, seq_id_t> fswm_internal::namesToSeqIDs = std::unordered_map<std::string, seq_id_t>();
-
-// Only mappings between reference sequences and ids
-std::unordered_map<seq_id_t, std::string> fswm_internal::genomeIDsToNames = std::unordered_map<seq_id_t, std::string>();
-std::unordered_map<std::string, seq_id_t> fswm_internal::namesToGenomeIDs = std::unordered_map<std::string, seq_id_t>();
-
-// Mappings between query sequences and ids
-std::unordered_map<seq_id_t, std::string> fswm_internal::readIDsToNames = std::unordered_map<seq_id_t, std::string>();
-std::unordered_map<std::string, seq_id_t> fswm_internal::namesToReadIDs = std::unordered_map<std::string, seq_id_t>();
-std::unordered_map<seq_id_t, seq_id_t> fswm_internal::IDsToPlacementIDs = std::unordered_map<seq_id_t, seq_id_t>();
-std::unordered_map<seq_id_t, seq_id_t> fswm_internal::placementIDsToIDs = std::unordered_map<seq_id_t, seq_id_t>();
-
-int fswm_internal::g_numberGenomes = 0;
-bool fswm_internal::jplace_tracking = true;
-
-bool GlobalParameters::save_parameters() {
-	std::ofstream foutstream(fswm_params::g_outfoldername + "fswm_parameters.txt");
+uint32_t fswm_params::g_topReferences = 0;
+uint64_t fswm_params::g_maxGroupPairs = 0;
+std::string fswm_params::g_largeGroups = "sample";
+bool fswm_params::g_dereplicate = false;
+uint32_t fswm_params::g_numPlacements = 1;
+
+bool GlobalParameters::save_parameters(const Parameters &params) {
+	std::ofstream foutstream(params.outfoldername + "fswm_parameters.txt");
 	foutstream << "  Parameters : {" << std::endl;
-	foutstream << "\treference : " << fswm_params::g_genomesfname << "," << std::endl;
-	foutstream << "\ttree : " << fswm_params::g_reftreefname << "," << std::endl;
-	foutstream << "\tquery : " << fswm_params::g_readsfname << "," << std::endl;
-	foutstream << "\tout_jplace : " << fswm_params::g_outjplacename << "," << std::endl;
-	foutstream << "\tweight : " << fswm_params::g_weight << "," << std::endl;
-	foutstream << "\tspaces : " << fswm_params::g_spaces << "," << std::endl;
-	foutstream << "\tmode : " << fswm_params::g_assignmentMode << "," << std::endl;
-	foutstream << "\tread_block_size : " << fswm_params::g_readBlockSize << "," << std::endl;
+	foutstream << "\treference : " << params.genomesfname << "," << std::endl;
+	if (!params.indexfoldername.empty()) {
+		foutstream << "\tindex : " << params.indexfoldername << "," << std::endl;
+	}
+	foutstream << "\ttree : " << params.reftreefname << "," << std::endl;
+	foutstream << "\tquery : " << params.readsfname << "," << std::endl;
+	foutstream << "\tout_jplace : " << params.outjplacename << "," << std::endl;
+	foutstream << "\tweight : " << params.weight << "," << std::endl;
+	foutstream << "\tspaces : " << params.spaces << "," << std::endl;
+	foutstream << "\tmode : " << params.assignmentMode << "," << std::endl;
+	if (params.autoReadBlockSize) {
+		foutstream << "\tread_block_size : auto," << std::endl;
+	}
+	else {
+		foutstream << "\tread_block_size : " << params.readBlockSize << "," << std::endl;
+	}
+	foutstream << "\ttop_k : " << params.topReferences << "," << std::endl;
+	if (params.maxGroupPairs > 0) {
+		foutstream << "\tmax_group_pairs : " << params.maxGroupPairs << "," << std::endl;
+		foutstream << "\tlarge_groups : " << params.largeGroups << "," << std::endl;
+	}
+	foutstream << "\tplacements : " << params.numPlacements << "," << std::endl;
+	foutstream << "\tpattern_seed : " << params.patternSeed << "," << std::endl;
+	if (params.memoryLimit > 0) {
+		foutstream << "\tmemory_limit : " << params.memoryLimit << "," << std::endl;
+	}
+	if (params.numaMode != "off") {
+		foutstream << "\tnuma : " << params.numaMode << "," << std::endl;
+	}
+	if (params.dereplicate) {
+		foutstream << "\tdereplicate : 1," << std::endl;
+	}
+	if (!params.patternfname.empty()) {
+		foutstream << "\tpattern_file : " << params.patternfname << "," << std::endl;
+	}
 	foutstream << "  }" << std::endl << "}" << std::endl;
 	foutstream.close();
 
@@ -127,11 +157,62 @@ bool GlobalParameters::load_parameters(std::string filename = "") {
 				fswm_params::g_threads = std::stoi(value);
 			}
 			if (key.find("read_block_size") != std::string::npos) {
-				fswm_params::g_readBlockSize = std::stoi(value);
+				fswm_params::g_autoReadBlockSize = value == "auto";
+				if (!fswm_params::g_autoReadBlockSize) {
+					fswm_params::g_readBlockSize = std::stoi(value);
+				}
 			}
 			if (key.find("verbose") != std::string::npos) {
 				fswm_params::g_verbose = std::stoi(value);
 			}
+			if (key.find("placements") != std::string::npos) {
+				fswm_params::g_numPlacements = std::stoi(value);
+			}
+			if (key.find("index") != std::string::npos) {
+				if (value.rfind("/", 0) == 0) {
+					fswm_params::g_indexfoldername = value;
+				}
+				else {
+					fswm_params::g_indexfoldername = param_folder + value;
+				}
+			}
+			if (key.find("pattern_file") != std::string::npos) {
+				if (value.rfind("/", 0) == 0) {
+					fswm_params::g_patternfname = value;
+				}
+				else {
+					fswm_params::g_patternfname = param_folder + value;
+				}
+			}
+			if (key.find("pattern_seed") != std::string::npos) {
+				uint64_t seed = 0;
+				if (!parse_number(value, UINT32_MAX, seed)) {
+					std::cerr << "ERROR: Invalid pattern_seed in parameter file: " << value << std::endl;
+					exit (EXIT_FAILURE);
+				}
+				fswm_params::g_patternSeed = seed;
+			}
+			if (key.find("memory_limit") != std::string::npos) {
+				fswm_params::g_memoryLimit = std::stoull(value);
+			}
+			if (key.find("numa") != std::string::npos) {
+				fswm_params::g_numaMode = value;
+			}
+			if (key.find("dereplicate") != std::string::npos) {
+				fswm_params::g_dereplicate = std::stoi(value) != 0;
+			}
+			if (key.find("max_group_pairs") != std::string::npos) {
+				if (!parse_number(value, UINT64_MAX, fswm_params::g_maxGroupPairs)) {
+					std::cerr << "ERROR: Invalid max_group_pairs in parameter file: " << value << std::endl;
+					exit (EXIT_FAILURE);
+				}
+			}
+			if (key.find("large_groups") != std::string::npos) {
+				fswm_params::g_largeGroups = value;
+			}
+			if (key.find("top_k") != std::string::npos) {
+				fswm_params::g_topReferences = std::stoi(value);
+			}
 			if (key.find("threshold") != std::string::npos) {
 				fswm_params::g_filteringThresholdMultiplicator = std::stoi(value);
 				calculate_filteringThreshold();
@@ -177,7 +258,7 @@ bool GlobalParameters::load_parameters(std::string filename = "") {
 /** Parse option parameters from parameter file or command line. */
 bool GlobalParameters::parse_parameters(int argc, char *argv[]) {
 	int option_param;
-	std::string possible_params = "l:s:t:q:o:w:d:hm:b:vp:ux:";
+	std::string possible_params = "l:s:t:q:o:w:d:hm:b:vp:ux:i:";
 	bool usingParameterfile = false;
 
     int index = -1;
@@ -206,6 +287,22 @@ bool GlobalParameters::parse_parameters(int argc, char *argv[]) {
         { "write-parameter", no_argument, 		nullptr, 7   },
         { "write-ids", no_argument, 			nullptr, 8   },
         { "hashlimit", required_argument, 		nullptr, 9   },
+        { "top-k", required_argument, 			nullptr, 10  },
+        { "placements", required_argument, 		nullptr, 11  },
+        { "out-format", required_argument, 		nullptr, 12  },
+        { "scores-format", required_argument, 	nullptr, 13  },
+        { "histogram-pairs", no_argument, 		nullptr, 14  },
+        { "write-report", no_argument, 			nullptr, 15  },
+        { "pattern-seed", required_argument, 	nullptr, 16  },
+        { "pattern-cache", required_argument, 	nullptr, 17  },
+        { "pattern-file", required_argument, 	nullptr, 18  },
+        { "memory-limit", required_argument, 	nullptr, 19  },
+        { "tmp-dir", required_argument, 		nullptr, 20  },
+        { "numa", required_argument, 			nullptr, 21  },
+        { "max-group-pairs", required_argument, nullptr, 22  },
+        { "large-groups", required_argument, 	nullptr, 23  },
+        { "dereplicate", no_argument, 			nullptr, 24  },
+        { "index", required_argument, 			nullptr, 'i' },
         0
     };
 
@@ -238,6 +335,9 @@ bool GlobalParameters::parse_parameters(int argc, char *argv[]) {
 			case 'q':
 				fswm_params::g_readsfname = optarg;
 				break;
+			case 'i':
+				fswm_params::g_indexfoldername = optarg;
+				break;
 			case 'o':
 				fswm_params::g_outjplacename = optarg;
 				if (fswm_params::g_outjplacename.find('/') != std::string::npos) {
@@ -263,7 +363,10 @@ bool GlobalParameters::parse_parameters(int argc, char *argv[]) {
 				exit (EXIT_SUCCESS);
 				break;
 			case 'b':
-				fswm_params::g_readBlockSize = atoi(optarg);
+				fswm_params::g_autoReadBlockSize = std::string(optarg) == "auto";
+				if (!fswm_params::g_autoReadBlockSize) {
+					fswm_params::g_readBlockSize = atoi(optarg);
+				}
 				break;
 			case 'v':
 				fswm_params::g_verbose = true;
@@ -305,6 +408,68 @@ bool GlobalParameters::parse_parameters(int argc, char *argv[]) {
 			case 9:
 				fswm_params::g_minHashLowerLimit = atoi(optarg);
 				break;
+			case 10:
+				fswm_params::g_topReferences = atoi(optarg);
+				break;
+			case 11:
+				fswm_params::g_numPlacements = atoi(optarg);
+				break;
+			case 12:
+				fswm_params::g_outputFormat = optarg;
+				break;
+			case 13:
+				fswm_params::g_scoresFormat = optarg;
+				break;
+			case 14:
+				fswm_params::g_writeHistogram = true;
+				fswm_params::g_histogramPerPair = true;
+				break;
+			case 15:
+				fswm_params::g_writeReport = true;
+				break;
+			case 16: {
+				uint64_t seed = 0;
+				if (!parse_number(optarg, UINT32_MAX, seed)) {
+					std::cerr << "ERROR: Pattern seed must be a number between 0 and " << UINT32_MAX << "." << std::endl;
+					exit (EXIT_FAILURE);
+				}
+				fswm_params::g_patternSeed = seed;
+				break;
+			}
+			case 17:
+				fswm_params::g_patternCache = optarg;
+				if (fswm_params::g_patternCache == "none") {
+					fswm_params::g_patternCache = "";
+				}
+				break;
+			case 18:
+				fswm_params::g_patternfname = optarg;
+				break;
+			case 19:
+				fswm_params::g_memoryLimit = parse_bytes(optarg);
+				if (fswm_params::g_memoryLimit == 0) {
+					std::cerr << "ERROR: Memory limit must be a positive number of bytes with optional suffix K, M, G or T." << std::endl;
+					exit (EXIT_FAILURE);
+				}
+				break;
+			case 20:
+				fswm_params::g_tmpfoldername = optarg;
+				break;
+			case 21:
+				fswm_params::g_numaMode = optarg;
+				break;
+			case 22:
+				if (!parse_number(optarg, UINT64_MAX, fswm_params::g_maxGroupPairs)) {
+					std::cerr << "ERROR: Maximum number of word group pairs must be a non-negative number." << std::endl;
+					exit (EXIT_FAILURE);
+				}
+				break;
+			case 23:
+				fswm_params::g_largeGroups = optarg;
+				break;
+			case 24:
+				fswm_params::g_dereplicate = true;
+				break;
 			case '?':
 				print_help();
 				exit (EXIT_SUCCESS);
@@ -314,7 +479,7 @@ bool GlobalParameters::parse_parameters(int argc, char *argv[]) {
 	return true;
 }
 
-bool GlobalParameters::check_parameters() {
+bool GlobalParameters::check_parameters(bool queriesRequired) {
 	if(fswm_params::g_weight < 2 || fswm_params::g_weight > 32) {
 		std::cerr << "ERROR: Weight (-k) must be between 2 and 32"<< std::endl;
 		print_to_console();
@@ -326,7 +491,7 @@ bool GlobalParameters::check_parameters() {
 		exit (EXIT_FAILURE);
 	}
 	if (fswm_params::g_assignmentMode != "SPAMCOUNT" and fswm_params::g_assignmentMode != "MINDIST" and fswm_params::g_assignmentMode != "LCACOUNT" and fswm_params::g_assignmentMode != "LCADIST" and fswm_params::g_assignmentMode != "APPLES" and fswm_params::g_assignmentMode != "SPAMX") {
-		std::cerr << "ERROR: AssignmentMode must be \"SPAMCOUNT\" or \"MINDIST\" or \"LCACOUNT\" or \"LCADIST\" or \"APPLES\"."<< std::endl;
+		std::cerr << "ERROR: AssignmentMode must be \"SPAMCOUNT\" or \"MINDIST\" or \"LCACOUNT\" or \"LCADIST\" or \"SPAMX\" or \"APPLES\"."<< std::endl;
 		print_to_console();
 		exit (EXIT_FAILURE);
 	}
@@ -335,25 +500,80 @@ bool GlobalParameters::check_parameters() {
 		print_to_console();
 		exit (EXIT_FAILURE);
 	}
+	if (fswm_params::g_outputFormat != "jplace" and fswm_params::g_outputFormat != "jplace.gz" and fswm_params::g_outputFormat != "binary") {
+		std::cerr << "ERROR: Output format must be \"jplace\" or \"jplace.gz\" or \"binary\"."<< std::endl;
+		print_to_console();
+		exit (EXIT_FAILURE);
+	}
+	if (fswm_params::g_scoresFormat != "text" and fswm_params::g_scoresFormat != "binary") {
+		std::cerr << "ERROR: Scores format must be \"text\" or \"binary\"."<< std::endl;
+		print_to_console();
+		exit (EXIT_FAILURE);
+	}
+	if (fswm_params::g_numPlacements < 1) {
+		std::cerr << "ERROR: Number of placements per query must be at least 1."<< std::endl;
+		print_to_console();
+		exit (EXIT_FAILURE);
+	}
 	if(fswm_params::g_threads < 1) {
 		std::cerr << "ERROR: Threads (-t) must be an integer larger than 0."<< std::endl;
 		print_to_console();
 		exit (EXIT_FAILURE);
 	}
+	if (!fswm_params::g_indexfoldername.empty()) {
+		if (!std::ifstream(fswm_params::g_indexfoldername + "/references.idx").good()) {
+			std::cout << "ERROR: Please supply an existing reference index, see ./appspam index -h." << std::endl;
+			print_to_console();
+			exit (EXIT_FAILURE);
+		}
+		if (fswm_params::g_reftreefname.empty()) {
+			fswm_params::g_reftreefname = fswm_params::g_indexfoldername + "/tree.nwk";
+		}
+	}
+
 	std::ifstream f(fswm_params::g_genomesfname.c_str());
-	if (!f.good()) {
+	if (!f.good() and fswm_params::g_indexfoldername.empty()) {
 		std::cout << "ERROR: Please supply an existing file for the genomes." << std::endl;
 		print_to_console();
 		exit (EXIT_FAILURE);
 	}
 
 	std::ifstream g(fswm_params::g_readsfname.c_str());
-	if (!g.good()) {
+	if (!g.good() and queriesRequired) {
 		std::cout << "ERROR: Please supply an existing file for the reads." << std::endl;
 		print_to_console();
 		exit (EXIT_FAILURE);
 	}
 
+	if (!fswm_params::g_patternfname.empty() and !std::ifstream(fswm_params::g_patternfname).good()) {
+		std::cout << "ERROR: Please supply an existing file for the patterns." << std::endl;
+		print_to_console();
+		exit (EXIT_FAILURE);
+	}
+
+	struct stat tmpStat;
+	if (fswm_params::g_memoryLimit > 0 and (stat(fswm_params::g_tmpfoldername.c_str(), &tmpStat) != 0 or !S_ISDIR(tmpStat.st_mode))) {
+		std::cout << "ERROR: Please supply an existing folder for temporary files (--tmp-dir)." << std::endl;
+		print_to_console();
+		exit (EXIT_FAILURE);
+	}
+
+	if (fswm_params::g_numaMode != "off" and fswm_params::g_numaMode != "replicate" and fswm_params::g_numaMode != "interleave") {
+		std::cout << "ERROR: --numa must be off, replicate or interleave." << std::endl;
+		print_to_console();
+		exit (EXIT_FAILURE);
+	}
+	if (fswm_params::g_largeGroups != "sample" and fswm_params::g_largeGroups != "skip") {
+		std::cout << "ERROR: --large-groups must be sample or skip." << std::endl;
+		print_to_console();
+		exit (EXIT_FAILURE);
+	}
+	if (fswm_params::g_numaMode == "interleave" and !NumaTopology::interleave_available()) {
+		std::cout << "ERROR: --numa interleave needs appspam built with libnuma, use --numa replicate instead." << std::endl;
+		print_to_console();
+		exit (EXIT_FAILURE);
+	}
+
 	std::ifstream h(fswm_params::g_reftreefname.c_str());
 	if (!h.good() and !(fswm_params::g_reftreefname == "not set")) {
 		std::cout << "ERROR: Please supply an existing file for reference tree." << std::endl;
@@ -369,45 +589,149 @@ bool GlobalParameters::print_to_console() {
 	std::cout << "\tspaces  : " << fswm_params::g_spaces << std::endl;
 	std::cout << "\tthreads : " << fswm_params::g_threads << std::endl;
 	std::cout << "\tassignment : " << fswm_params::g_assignmentMode << std::endl;
-	std::cout << "\tread_block_size  : " << fswm_params::g_readBlockSize << std::endl;
+	std::cout << "\tread_block_size  : " << (fswm_params::g_autoReadBlockSize ? "auto" : std::to_string(fswm_params::g_readBlockSize)) << std::endl;
+	std::cout << "\ttop_k  : " << fswm_params::g_topReferences << std::endl;
+	std::cout << "\tmax_group_pairs  : " << fswm_params::g_maxGroupPairs << " (" << fswm_params::g_largeGroups << ")" << std::endl;
+	std::cout << "\tplacements  : " << fswm_params::g_numPlacements << std::endl;
+	std::cout << "\tdereplicate  : " << fswm_params::g_dereplicate << std::endl;
 	std::cout << "\tVerbose  : " << fswm_params::g_verbose << std::endl;
 	std::cout << "\treference  : " << fswm_params::g_genomesfname << std::endl;
 	std::cout << "\tquery  : " << fswm_params::g_readsfname << std::endl;
 	std::cout << "\ttree  : " << fswm_params::g_reftreefname << std::endl;
 	std::cout << "\tout_jplace  : " << fswm_params::g_outjplacename << std::endl;
 	std::cout << "\tout_folder  : " << fswm_params::g_outfoldername << std::endl;
+	std::cout << "\tout_format  : " << fswm_params::g_outputFormat << std::endl;
 	return true;
 }
 
-void GlobalParameters::write_genome_ids_to_file() {
-	std::ofstream genomeIDsStream(fswm_params::g_outfoldername + "genomeIDsToNames.txt");
-	for (auto const &entry : fswm_internal::genomeIDsToNames) {
+void GlobalParameters::write_genome_ids_to_file(std::string outfoldername, const SequenceRegistry &registry) {
+	std::ofstream genomeIDsStream(outfoldername + "genomeIDsToNames.txt");
+	for (auto const &entry : registry.get_genomes()) {
 		genomeIDsStream << entry.first << "\t" << entry.second << std::endl;
 	}
 	genomeIDsStream.close();
 }
 
-void GlobalParameters::write_seq_ids_to_file() {
-	std::ofstream seqIDsOutStream(fswm_params::g_outfoldername + "namesToSeqIDs.txt");
-	for (auto const &entry : fswm_internal::namesToSeqIDs) {
+void GlobalParameters::write_seq_ids_to_file(std::string outfoldername, const SequenceRegistry &registry) {
+	std::ofstream seqIDsOutStream(outfoldername + "namesToSeqIDs.txt");
+	for (auto const &entry : registry.get_seqIDs()) {
 		seqIDsOutStream << entry.first << "\t" << entry.second << std::endl;
 	}
 	seqIDsOutStream.close();
 }
 
-void GlobalParameters::write_read_ids_to_file() {
-	std::ofstream seqIDsOutStream(fswm_params::g_outfoldername + "readsToSeqIDs.txt");
-	for (auto const &entry : fswm_internal::readIDsToNames) {
-		seqIDsOutStream << entry.first << "\t" << entry.second << std::endl;
+void GlobalParameters::write_read_ids_to_file(std::string outfoldername, const std::vector<Sequence> &reads) {
+	std::ofstream seqIDsOutStream(outfoldername + "readsToSeqIDs.txt");
+	for (auto const &read : reads) {
+		seqIDsOutStream << read.get_seqID() << "\t" << read.get_header() << std::endl;
 	}
 	seqIDsOutStream.close();
 }
 
+/** Cache folder of optimized patterns, $XDG_CACHE_HOME/appspam or $HOME/.cache/appspam. */
+std::string GlobalParameters::default_patternCache() {
+	const char *cacheHome = getenv("XDG_CACHE_HOME");
+	if (cacheHome != nullptr and cacheHome[0] != '\0') {
+		return std::string(cacheHome) + "/appspam/";
+	}
+	const char *home = getenv("HOME");
+	if (home != nullptr and home[0] != '\0') {
+		return std::string(home) + "/.cache/appspam/";
+	}
+	return "";
+}
+
+uint64_t GlobalParameters::parse_bytes(std::string value) {
+	size_t end = 0;
+	uint64_t bytes = 0;
+	try {
+		bytes = std::stoull(value, &end);
+	}
+	catch (const std::exception&) {
+		return 0;
+	}
+	std::string suffix = value.substr(end);
+	const std::string units = "KMGT";
+	if (suffix.size() > 1 or (suffix.size() == 1 and units.find(toupper(suffix[0])) == std::string::npos)) {
+		return 0;
+	}
+	if (suffix.size() == 1) {
+		bytes <<= 10 * (units.find(toupper(suffix[0])) + 1);
+	}
+	return bytes;
+}
+
+bool GlobalParameters::parse_number(std::string value, uint64_t max, uint64_t &number) {
+	if (value.empty() or !isdigit(value[0])) {
+		return false;
+	}
+	size_t end = 0;
+	try {
+		number = std::stoull(value, &end);
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+	return end == value.size() and number <= max;
+}
+
 int GlobalParameters::calculate_filteringThreshold() {
 	fswm_params::g_filteringThreshold = fswm_params::g_spaces * fswm_params::g_filteringThresholdMultiplicator;
 	return fswm_params::g_spaces * fswm_params::g_filteringThresholdMultiplicator;
 }
 
+void GlobalParameters::calculate_filteringThreshold(Parameters &params) {
+	params.filteringThreshold = params.spaces * params.filteringThresholdMultiplicator;
+}
+
+Parameters GlobalParameters::get_parameters() {
+	Parameters params;
+	params.weight = fswm_params::g_weight;
+	params.spaces = fswm_params::g_spaces;
+	params.assignmentMode = fswm_params::g_assignmentMode;
+	params.threads = fswm_params::g_threads;
+	params.readBlockSize = fswm_params::g_readBlockSize;
+	params.autoReadBlockSize = fswm_params::g_autoReadBlockSize;
+	params.memoryLimit = fswm_params::g_memoryLimit;
+	params.tmpfoldername = fswm_params::g_tmpfoldername;
+	params.numaMode = fswm_params::g_numaMode;
+	params.verbose = fswm_params::g_verbose;
+	params.writeHistogram = fswm_params::g_writeHistogram;
+	params.histogramPerPair = fswm_params::g_histogramPerPair;
+	params.writeScoring = fswm_params::g_writeScoring;
+	params.writeReport = fswm_params::g_writeReport;
+	params.scoresFormat = fswm_params::g_scoresFormat;
+	params.writeParameter = fswm_params::g_writeParameter;
+	params.writeIDs = fswm_params::g_writeIDs;
+	params.filteringThreshold = fswm_params::g_filteringThreshold;
+	params.filteringThresholdMultiplicator = fswm_params::g_filteringThresholdMultiplicator;
+	params.sampling = fswm_params::g_sampling;
+	params.minHashLowerLimit = fswm_params::g_minHashLowerLimit;
+	params.draftGenomes = fswm_params::g_draftGenomes;
+	params.delimiter = fswm_params::g_delimiter;
+	params.numPatterns = fswm_params::g_numPatterns;
+	params.patternSeed = fswm_params::g_patternSeed;
+	params.patternfname = fswm_params::g_patternfname;
+	params.patternCache = fswm_params::g_patternCache;
+	params.defaultDistance = fswm_params::g_defaultDistance;
+	params.spamX = fswm_params::g_spam_X;
+	params.topReferences = fswm_params::g_topReferences;
+	params.maxGroupPairs = fswm_params::g_maxGroupPairs;
+	params.largeGroups = fswm_params::g_largeGroups;
+	params.dereplicate = fswm_params::g_dereplicate;
+	params.numPlacements = fswm_params::g_numPlacements;
+	params.genomesfname = fswm_params::g_genomesfname;
+	params.reftreefname = fswm_params::g_reftreefname;
+	params.readsfname = fswm_params::g_readsfname;
+	params.outjplacename = fswm_params::g_outjplacename;
+	params.outfoldername = fswm_params::g_outfoldername;
+	params.paramfname = fswm_params::g_paramfname;
+	params.indexfoldername = fswm_params::g_indexfoldername;
+	params.outputFormat = fswm_params::g_outputFormat;
+	params.defaultDistanceNewLeaves = fswm_params::default_distance_new_leaves;
+	return params;
+}
+
 /**
  * Print helpfile and exit.
  */
@@ -420,6 +744,15 @@ A typical call might look like:
 	./appspam -h
 	./appspam -s references.fasta -q query.fasta -t tree.nwk
 	./appspam -s references.fasta -q query.fasta -t tree.nwk -d 10 -w 8
+	./appspam -i reference_index -q query.fasta
+
+A reference index is created and updated with:
+	./appspam index -i reference_index --add references.fasta --tree tree.nwk
+	./appspam index -h
+
+Queries are placed over a Unix domain socket by a server with:
+	./appspam serve -i reference_index --socket /tmp/appspam.sock
+	./appspam serve -h
 
 The following parameters are necessary:
     -s 	Reference sequences.
@@ -431,18 +764,35 @@ The following parameters are necessary:
         (Rooted, bifurcating tree in newick format.
         All leaves must have identical names to reference sequences.)
 
+Instead of -s (and -t) a reference index can be given:
+    -i  --index             Folder of a reference index. Weight, don't cares,
+                            patterns and sampling of the index are used.
+                            The tree of the index is used if -t is not given.
+
 The following parameters are optional.
     -o  --out_jplace        Path and name to JPlace output file.
 
+        --out-format        Format of placement output.
+                            One of [jplace, jplace.gz, binary]
+                            jplace.gz appends .gz and binary appends .bplace
+                            to the output file name. Binary files are converted
+                            to JPlace with appspam_convert.
+
     -w  --weight            Weight of pattern.
 
     -d  --dontCare          Number of don't care positions.
 
     -m  --mode              Placement-mode.
-                            One of [MINDIST, SPAMCOUNT, LCADIST, LCACOUNT, SPAMX]
+                            One of [MINDIST, SPAMCOUNT, LCADIST, LCACOUNT, SPAMX, APPLES]
+                            APPLES places queries by weighted least squares
+                            on the query-reference distances.
 
     -x  --spamx             Threshold when to place at leaves for SPAMX.
 
+        --placements        Maximum number of weighted placements per query
+                            (default 1). Weights are derived from spaced word
+                            counts or distances; not used with APPLES.
+
     -u  --unassembled       Use unassembled references, 
                             see github repository for more information.
 
@@ -450,20 +800,70 @@ The following parameters are optional.
 		
     -p  --pattern           Number of patterns.
 
+        --pattern-seed      Seed of the pattern optimization (default 0).
+
+        --pattern-cache     Folder in which optimized patterns are cached
+                            (default $XDG_CACHE_HOME/appspam or
+                            ~/.cache/appspam, none disables the cache).
+
+        --pattern-file      File with patterns of 1 (match) and 0 (don't care)
+                            positions, one per line, that are used without
+                            optimization. All patterns must have the same
+                            length and weight; -w, -d and -p are ignored.
+
         --threads           Number of threads.
 
         --sampling          Experimental: Samples the spaced word matches.
 
-    -b  --readBlockSize     Read block size.
+    -b  --readBlockSize     Read block size, or auto to choose the block size
+                            and number of partitions placed in parallel from
+                            the number of spaced words, threads and memory
+                            (memory limit or half of the physical memory).
 
         --threshold         Threshold used for filtering spaced word matches. 
 
+        --memory-limit      Memory for spaced words of references and queries,
+                            e.g. 8G (default unlimited). Reference words that
+                            do not fit are sorted on disk and streamed, and
+                            the read block size is reduced if necessary.
+
+        --tmp-dir           Folder for temporary files (default $TMPDIR or /tmp).
+
+        --numa              Placement of reference words on NUMA nodes
+                            (off, replicate or interleave; default off).
+                            replicate copies them to every node and pins
+                            threads to nodes, interleave (needs libnuma)
+                            spreads one copy over all nodes.
+
+        --top-k             Keep only the k references with most spaced word
+                            matches per query (default 0 keeps all).
+                            References are already reduced while matching,
+                            so very small k can change placements.
+
+        --max-group-pairs   Compare at most this many word pairs of a query
+                            and a reference word group with the same matches,
+                            e.g. 1000000 (default 0 compares all). Bounds the
+                            time spent on repeats and low-complexity regions.
+        --large-groups      Handling of larger groups: sample (compare an
+                            evenly spread subset of the pairs, default) or skip.
+
+        --dereplicate       Place queries with identical sequences only once.
+                            Their placement lists all of their names in nm.
+
 Following additional flags exist:
     -h                      Print out help and exit.
     -v                      Turn on verbose mode with additional 
 	                        information printed to std_out.
         --write-scores      Write all query-reference distances to files.
-        --write-histogram   Write scores for all spaced word matches to file.
+        --scores-format     Format of written distances, one of [text, binary].
+                            binary writes one float32 matrix scoring.bscore
+                            that is converted to text with appspam_convert.
+        --write-histogram   Write histogram of the scores of all spaced word
+                            matches to file histogram.txt.
+        --histogram-pairs   Write the histogram separately for every
+                            query-reference pair (implies --write-histogram).
+        --write-report      Write timings and counters of all phases and
+                            peak memory to run_report.json.
 
 )"""";
 }
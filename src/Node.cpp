@@ -16,9 +16,8 @@
 
 #include <iostream>
 #include "Node.h"
-#include "SeqIO.h"
 
-Node::Node(std::string name) {
+Node::Node(std::string name, SequenceRegistry &registry) {
 	this->parent = nullptr;
 	this->distance = 0;
 	this->similarityScore = -1;
@@ -26,14 +25,12 @@ Node::Node(std::string name) {
 	this->leaves_below = -1;
 	this->name = name;
 
-	if (fswm_internal::namesToSeqIDs.find(name) != fswm_internal::namesToSeqIDs.end()) { // Use existing ID for leaves
-		this->ID = fswm_internal::namesToSeqIDs[name];
+	if (registry.has_sequence(name)) { // Use existing ID for leaves
+		this->ID = registry.get_seqID(name);
 	}
 	else {		// Create new sequence ID for internal nodes that reads can be assigned to
-		SeqIO::seqID_counter++;
-		this->ID = SeqIO::seqID_counter;
-		fswm_internal::seqIDsToNames[this->ID] = name;
-		fswm_internal::namesToSeqIDs[this->name] = this->ID;
+		this->ID = registry.new_seqID();
+		registry.register_sequence(this->ID, name);
 	}
 }
 
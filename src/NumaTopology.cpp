@@ -0,0 +1,161 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sched.h>
+#include <algorithm>
+#ifdef HAVE_NUMA
+#include <numa.h>
+#endif
+#include "NumaTopology.h"
+
+thread_local uint32_t NumaTopology::threadNode = 0;
+
+static cpu_set_t read_process_cpus() {
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) {
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			CPU_SET(cpu, &cpus);
+		}
+	}
+	return cpus;
+}
+
+/** CPU affinity of the process before any thread was pinned. */
+static const cpu_set_t& process_cpus() {
+	static const cpu_set_t cpus = read_process_cpus();
+	return cpus;
+}
+
+/** Parse a kernel cpu or node list such as 0-3,8-11. */
+static std::vector<int> parse_list(const std::string &list) {
+	std::vector<int> entries;
+	std::stringstream listStream(list);
+	std::string range;
+	while (std::getline(listStream, range, ',')) {
+		if (range.empty()) {
+			continue;
+		}
+		size_t dash = range.find('-');
+		int first = std::stoi(range.substr(0, dash));
+		int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+		for (int entry = first; entry <= last; entry++) {
+			entries.push_back(entry);
+		}
+	}
+	return entries;
+}
+
+/**
+ * Nodes are numbered in the order of the kernel's node numbers, leaving out
+ * nodes without CPUs (e.g. memory-only nodes) and CPUs outside of the affinity
+ * of the process.
+ */
+static std::vector<std::vector<int>> read_nodes() {
+	std::vector<std::vector<int>> nodes;
+	const cpu_set_t &allowed = process_cpus();
+
+	std::string onlineNodes;
+	std::ifstream onlineStream("/sys/devices/system/node/online");
+	std::getline(onlineStream, onlineNodes);
+	for (int node : parse_list(onlineNodes)) {
+		std::string cpulist;
+		std::ifstream cpulistStream("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		std::getline(cpulistStream, cpulist);
+
+		std::vector<int> cpus;
+		for (int cpu : parse_list(cpulist)) {
+			if (cpu < CPU_SETSIZE and CPU_ISSET(cpu, &allowed)) {
+				cpus.push_back(cpu);
+			}
+		}
+		if (!cpus.empty()) {
+			nodes.push_back(cpus);
+		}
+	}
+
+	if (nodes.empty()) {
+		std::vector<int> cpus;
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &allowed)) {
+				cpus.push_back(cpu);
+			}
+		}
+		nodes.push_back(cpus);
+	}
+	return nodes;
+}
+
+const std::vector<std::vector<int>>& NumaTopology::get_nodes() {
+	static const std::vector<std::vector<int>> nodes = read_nodes();
+	return nodes;
+}
+
+uint32_t NumaTopology::get_thread_node(int threadNum, int) {
+	return threadNum % get_nodeCount();
+}
+
+bool NumaTopology::pin_thread(uint32_t node) {
+	const std::vector<std::vector<int>> &nodes = get_nodes();
+	if (node >= nodes.size()) {
+		return false;
+	}
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	for (int cpu : nodes[node]) {
+		CPU_SET(cpu, &cpus);
+	}
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+		return false;
+	}
+	threadNode = node;
+	return true;
+}
+
+void NumaTopology::unpin_thread() {
+	sched_setaffinity(0, sizeof(cpu_set_t), &process_cpus());
+	threadNode = 0;
+}
+
+bool NumaTopology::interleave_available() {
+#ifdef HAVE_NUMA
+	return numa_available() >= 0;
+#else
+	return false;
+#endif
+}
+
+/** The policy applies to pages touched for the first time afterwards. */
+bool NumaTopology::set_interleaved_allocation(bool interleaved) {
+#ifdef HAVE_NUMA
+	if (!interleave_available()) {
+		return false;
+	}
+	if (interleaved) {
+		numa_set_interleave_mask(numa_all_nodes_ptr);
+	}
+	else {
+		numa_set_localalloc();
+	}
+	return true;
+#else
+	(void) interleaved;
+	return false;
+#endif
+}
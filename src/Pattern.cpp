@@ -16,10 +16,6 @@
 #include "Pattern.h"
 
 
-/*---Variables---------------------------------------------------------------*/
-
-std::default_random_engine generator(std::random_device{}());
-
 /*---Constructor-& Init------------------------------------------------------*/
 /**
  * Default constructor, sets the default vaulues, pattern will be generated automatically.
@@ -54,7 +50,7 @@ Pattern::Pattern(long size, long length, int weight, uint seed) {
 	this->quiet = false;
 	this->silent = false;
 	this->secure = false;
-	generator.seed(seed);
+	this->generator.seed(seed);
 	ReinitPattern();
 }
 
@@ -396,26 +392,54 @@ double Pattern::Variance() {
  * @return Calculates and returns current variance
  */
 double Pattern::CalcVariance() {
-	double homologue, background, var_hom, var_bac;
-	int shift;
+	double homologue, background;
 
-	homologue = 0.0;
-	background = 0.0;
+	/*Bit i of a mask is set if position i of the pattern is a match position*/
+	masks.assign(size, 0);
+	for(int i = 0; i < size; i++) {
+		for(int k = 0; k < length; k++) {
+			if(pattern_set[i][k] == '1') {
+				masks[i] |= (uint64_t) 1 << k;
+			}
+		}
+	}
+
+	/*Powers of p and q for all possible numbers of match positions of two shifted patterns*/
+	if(pow_p.size() != (size_t) 2*weight+1) {
+		pow_p.resize(2*weight+1);
+		pow_q.resize(2*weight+1);
+		for(int k = 0; k <= 2*weight; k++) {
+			pow_p[k] = pow(p, k);
+			pow_q[k] = pow(q, k);
+		}
+	}
+
+	/*The shares of all pattern pairs are independent and calculated in parallel*/
+	std::vector<double> var_hom(size*size, 0.0), var_bac(size*size, 0.0);
+	#pragma omp parallel for schedule(dynamic) if(size >= 16)
 	for(int i = 0; i < size; i++) {							/*i and j represents Pi and Pj of the set of pattern*/
 		for(int j = i; j < size; j++) {
-			var_hom = 0.0;
-			var_bac = 0.0;
+			double hom = 0.0;
+			double bac = 0.0;
 			for(int s = -1*length+1; s < length; s++) {			/*As in the formula, the shift goes from max shift left to max shift right*/
-				shift = ShiftPos(i, j, s);				/*At least one position has to overlap*/
-				var_hom += (pow(p, shift) - pow(p, 2*weight));		/*summation of the homologue first part*/
-				var_bac += (pow(q, shift) - pow(q, 2*weight));		/*summation of the background second part*/
+				int shift = ShiftPos(i, j, s);				/*At least one position has to overlap*/
+				hom += (pow_p[shift] - pow_p[2*weight]);		/*summation of the homologue first part*/
+				bac += (pow_q[shift] - pow_q[2*weight]);		/*summation of the background second part*/
 			}
-			var_sum[i][j]=(length - length + 1)*var_hom + (length - length + 1)*(length - length)*var_bac;		/*For each pair Pi and Pj this is the direct share of the complete variance...*/
+			var_sum[i][j]=(length - length + 1)*hom + (length - length + 1)*(length - length)*bac;		/*For each pair Pi and Pj this is the direct share of the complete variance...*/
 			var_sum[j][i]=var_sum[i][j];									/*...which we can use to estimate a "worst" pattern*/
 											/*... and save it in an size x size matrix*/
-			homologue += var_hom;
-			background += var_bac;
+			var_hom[i*size+j] = hom;
+			var_bac[i*size+j] = bac;
+		}
+	}
 
+	homologue = 0.0;
+	background = 0.0;
+	for(int i = 0; i < size; i++) {							/*Summation in fixed order, independent of the number of threads*/
+		for(int j = i; j < size; j++) {
+			homologue += var_hom[i*size+j];
+			background += var_bac[i*size+j];
 		}
 	}
 	this->variance = (length - length + 1)*homologue + (length - length + 1)*(length - length)*background;
@@ -442,40 +466,21 @@ double Pattern::CalcVariance() {
  * @return Calculates and returns current variance
  */
 int Pattern::ShiftPos(int p1, int p2, int s) {
-	int counter;
-
-	std::string pat1, pat2;
-
-	counter = 0;
+	uint64_t pat1, pat2;
 
 	if(s < 0) {
 		s = 0 - s;
-		pat1 = pattern_set[p2];				/*If s < 0 for pat2 it is in the point of view for pat1 like s > 0*/
-		pat2 = pattern_set[p1];				/*Therefore changing the pattern and take the absolute value from s is easier*/
+		pat1 = masks[p2];				/*If s < 0 for pat2 it is in the point of view for pat1 like s > 0*/
+		pat2 = masks[p1];				/*Therefore changing the pattern and take the absolute value from s is easier*/
 	}
 	else{
-		pat1 = pattern_set[p1];
-		pat2 = pattern_set[p2];
-	}
-								/*Afterwards the second pattern (may changed) is only shifted left, its easier*/
-
-	for(int i = 0; i < s; i++) {				/*The pattern section from only pattern 1*/
-		if(pat1[i] == '1') {
-			counter++;
-		}
-	}
-	for(int i = 0; i < (length-s); i++) {			/*The common section of the pattern*/
-		if(pat1[i+s] == '1' || pat2[i] == '1') {
-			counter++;
-		}
-	}
-	for(int i = length-s; i < length; i++) {			/*The pattern section from only pattern 2*/
-		if(pat2[i] == '1') {
-			counter++;
-		}
+		pat1 = masks[p1];
+		pat2 = masks[p2];
 	}
 
-	return counter;
+	/*Match positions of both patterns minus the positions where both overlap.
+	 Positions of pattern 2 shifted beyond the pattern length cannot overlap, so 64 bits suffice.*/
+	return 2*weight - __builtin_popcountll(pat1 & (pat2 << s));
 }
 
 /**
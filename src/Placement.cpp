@@ -15,134 +15,226 @@
  */
 
 #include "Placement.h"
-#include "BucketManager.h"
 #include "GenomeManager.h"
 #include "ReadManager.h"
-#include "Sequence.h"
-#include "Algorithms.h"
-#include "Tree.h"
 #include "GlobalParameters.h"
-#include <omp.h>
+#include "Pattern.h"
+#include "Profiler.h"
 #include <iostream>
 #include <fstream>
-#include <cstdlib>
-#include "Algorithms.h"
-#include "Scoring.h"
-#include "SubstitutionMatrix.h"
-#include "Match.h"
-#include "MatchManager.h"
-
-void Placement::phylogenetic_placement() {
-	// Initialize pattern
-	Pattern pattern = Pattern(fswm_params::g_numPatterns, fswm_params::g_weight + fswm_params::g_spaces,
-			fswm_params::g_weight, 0); // Create pattern with seed
+#include <algorithm>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+#include <unistd.h>
+#include <sys/stat.h>
 
+/**
+ * Patterns are read from the pattern file if one is given. Otherwise they are optimized.
+ * The optimization is deterministic for a seed, so its result is cached per
+ * weight, pattern length, number of patterns and seed.
+ */
+std::vector<std::string> Placement::create_patterns(Parameters &params) {
+	int length = params.weight + params.spaces;
+	std::vector<std::string> patterns;
+
+	// Patterns given by the user define weight, don't cares and number of patterns and are not optimized
+	if (!params.patternfname.empty()) {
+		std::string error;
+		if (!load_patterns(params.patternfname, patterns, error)) {
+			std::cerr << "ERROR: Invalid pattern file " << params.patternfname << ": " << error << "." << std::endl;
+			exit (EXIT_FAILURE);
+		}
+		params.numPatterns = patterns.size();
+		params.weight = std::count(patterns[0].begin(), patterns[0].end(), '1');
+		params.spaces = patterns[0].size() - params.weight;
+		GlobalParameters::calculate_filteringThreshold(params);
+		if (params.verbose) { std::cout << "-> Read " << patterns.size() << " patterns from " << params.patternfname << std::endl; }
+		return patterns;
+	}
+
+	std::string cachefname = "";
+	if (!params.patternCache.empty()) {
+		std::string folder = params.patternCache;
+		if (folder.back() != '/') {
+			folder += "/";
+		}
+		cachefname = folder + "patterns_w" + std::to_string(params.weight) + "_l" + std::to_string(length)
+				+ "_n" + std::to_string(params.numPatterns) + "_s" + std::to_string(params.patternSeed) + ".txt";
+		std::string error;
+		if (load_patterns(cachefname, patterns, error) and (int) patterns.size() == params.numPatterns
+				and (int) patterns[0].size() == length and std::count(patterns[0].begin(), patterns[0].end(), '1') == params.weight) {
+			if (params.verbose) { std::cout << "-> Read patterns from cache " << cachefname << std::endl; }
+			return patterns;
+		}
+	}
+
+	Pattern pattern = Pattern(params.numPatterns, length, params.weight, params.patternSeed);
 	pattern.Silent();
 	pattern.ImproveSecure();
 	pattern.Improve(10);
-
-	//pattern.Print();
-	std::vector<std::string> patterns = pattern.GetPattern();
-
-	if (fswm_params::g_verbose) { std::cout << "-> Pattern size : " << patterns.size() << std::endl; }
-
-	std::vector<Seed> seeds;
-	for (int i = 0; i < fswm_params::g_numPatterns; i++) {
-		Seed seed(fswm_params::g_weight, fswm_params::g_spaces);
-		seed.generate_pattern(patterns[i]);
-		seeds.push_back(seed);
+	patterns = pattern.GetPattern();
+
+	// The cache is optional, patterns are only written if the folder can be created
+	if (!cachefname.empty()) {
+		std::string folder = cachefname.substr(0, cachefname.find_last_of('/'));
+		for (size_t pos = folder.find('/', 1); ; pos = folder.find('/', pos + 1)) {
+			mkdir(folder.substr(0, pos).c_str(), 0755);
+			if (pos == std::string::npos) {
+				break;
+			}
+		}
+		save_patterns(cachefname, patterns);
 	}
+	return patterns;
+}
 
-	std::cout << "-> Reading sequences." << std::endl;
-	// Read reads
-	ReadManager	readManager(fswm_params::g_readsfname);
-
-	// Read genomes, create spaced words and organize BucketManagers
-	GenomeManager genomeManager(fswm_params::g_genomesfname, seeds);
-
-	if (fswm_params::g_writeIDs) { GlobalParameters::write_read_ids_to_file(); };
-	if (fswm_params::g_writeIDs) { GlobalParameters::write_seq_ids_to_file(); };
-
-	// Create empty output files
-	Placement::create_output_files();
+/**
+ * Patterns consist of 1 (match position) and 0 (don't care position) and are separated by
+ * new lines or any of '.', ' ', ',', ';' and tabs. Lines starting with # are comments.
+ */
+bool Placement::load_patterns(std::string filename, std::vector<std::string> &patterns, std::string &error) {
+	std::ifstream patternStream(filename);
+	if (!patternStream.is_open()) {
+		error = "could not open file";
+		return false;
+	}
 
-	Tree tree(fswm_params::g_reftreefname);				// Read and create reference tree
-	if (fswm_params::g_assignmentMode != "APPLES") {
-		tree.write_jplace_data_beginning();
+	std::vector<std::string> loaded;
+	std::string line;
+	while (std::getline(patternStream, line)) {
+		if (line.empty() or line[0] == '#') {
+			continue;
+		}
+		std::replace_if(line.begin(), line.end(), [](char c) { return c == '.' or c == ',' or c == ';' or c == '\t' or c == '\r'; }, ' ');
+		std::stringstream tokens(line);
+		std::string token;
+		while (tokens >> token) {
+			if (token.find_first_not_of("01") != std::string::npos) {
+				error = "pattern " + token + " contains characters other than 0 and 1";
+				return false;
+			}
+			loaded.push_back(token);
+		}
 	}
-	else {
-		fswm_params::g_writeScoring = true;
+	if (loaded.empty()) {
+		error = "no patterns found";
+		return false;
 	}
 
-	if (fswm_params::g_writeScoring) {
-		std::ofstream results;
-		results.open(fswm_params::g_outfoldername + "scoring_table.txt");
-
-		for (auto genome : fswm_internal::genomeIDsToNames) {		// Write columns names (references to file)
-			results << "\t" << genome.second;
-		}
-		results << std::endl;
-		results.close();
-
-		results.open(fswm_params::g_outfoldername + "scoring_list.txt");
-		results.close();
-	}
-
-	// Compare buckets of reads and genomes
-	std::cout << "-> Comparing reads and genomes." << std::endl;
-	#pragma omp parallel for
-	for (int currentPartition = 0; currentPartition < readManager.get_partitions(); currentPartition++) {
-		if (fswm_params::g_verbose) { std::cout << "-> Starting partition " << currentPartition << std::endl; }
-
-		BucketManager bucketManagerReads;
-		BucketManager bucketManagerGenomes;
-		std::vector<seq_id_t> readIDs;
-		#pragma omp critical
-		{
-		readIDs = readManager.get_next_partition_BucketManager(seeds, bucketManagerReads);
-		bucketManagerGenomes = genomeManager.get_BucketManager();
+	// All patterns share weight and length, because spaced words of all patterns are compared with the same scoring
+	long weight = std::count(loaded[0].begin(), loaded[0].end(), '1');
+	for (auto const &pattern : loaded) {
+		if (pattern.size() != loaded[0].size() or std::count(pattern.begin(), pattern.end(), '1') != weight) {
+			error = "all patterns must have the same length and number of match positions";
+			return false;
 		}
+	}
+	if (weight < 2 or weight > 32 or loaded[0].size() - weight < 2 or loaded[0].size() - weight > 32) {
+		error = "patterns must have between 2 and 32 match positions and between 2 and 32 don't care positions";
+		return false;
+	}
+	std::vector<std::string> sorted = loaded;
+	std::sort(sorted.begin(), sorted.end());
+	if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+		error = "patterns must be unique";
+		return false;
+	}
 
-		Scoring fswm_distances = Scoring();
+	patterns = loaded;
+	return true;
+}
+
+/** Written to a temporary file first, so concurrent runs never read a partially written file. */
+bool Placement::save_patterns(std::string filename, const std::vector<std::string> &patterns) {
+	std::string tmpfname = filename + "." + std::to_string(getpid()) + ".tmp";
+	std::ofstream patternStream(tmpfname);
+	for (auto const &pattern : patterns) {
+		patternStream << pattern << "\n";
+	}
+	patternStream.close();
+	if (!patternStream.good() or rename(tmpfname.c_str(), filename.c_str()) != 0) {
+		unlink(tmpfname.c_str());
+		return false;
+	}
+	return true;
+}
 
-		Algorithms::fswm_complete(bucketManagerGenomes, bucketManagerReads, fswm_distances);
+/**
+ * A partition needs memory for the spaced words of its queries (both strands, all
+ * patterns, bucket vectors can hold twice their words while growing) and for the
+ * entries of the Scoring maps of every query and matched reference.
+ *
+ * In auto mode the block size is the smallest one whose query words outnumber the
+ * reference words, so the scan through the reference buckets, which is repeated for
+ * every partition, takes at most half of the join. It is reduced so that every thread
+ * gets a partition and all concurrent partitions fit into the memory ceiling (memory
+ * limit or half of the physical memory, without the reference words in memory).
+ * If not even partitions of minReadBlockSize queries fit, fewer partitions are
+ * processed at the same time.
+ *
+ * A given block size is only reduced to fit into a quarter of the memory limit, but
+ * never below minReadBlockSize, because every partition scans all reference buckets
+ * again. If a single partition of that size does not fit, the run stops.
+ */
+int Placement::plan_partitions(ReadManager &readManager, GenomeManager &genomeManager, const Parameters &params) {
+	const double scoringBytesPerPair = 160;
+	const double minReadBlockSize = 100;
+	int concurrency = params.threads;
 
-		#pragma omp critical
-		{
-			std::cout << "\t-> Read partition " << currentPartition << ": Calculating distances." << std::endl;
-			fswm_distances.calculate_fswm_distances();
-			std::cout << "\t-> Read partition " << currentPartition << ": Placing reads in tree." << std::endl;
-			fswm_distances.phylogenetic_placement(readIDs);
+	if (readManager.get_readCount() == 0 or (!params.autoReadBlockSize and params.memoryLimit == 0)) {
+		return concurrency;
+	}
 
-			if (fswm_params::g_writeScoring or fswm_params::g_assignmentMode == "APPLES") {
-				fswm_distances.write_scoring_to_file();
-				fswm_distances.write_scoring_to_file_as_table();
-			}
-		}
+	double wordsPerRead = std::max((double) readManager.get_wordCount(params.numPatterns,
+			params.weight + params.spaces) / readManager.get_readCount(), 1.0);
+	double referencesPerRead = genomeManager.get_genomeCount();
+	if (params.topReferences > 0) {
+		referencesPerRead = std::min(referencesPerRead, 8.0 * params.topReferences);
 	}
+	double bytesPerRead = 2 * sizeof(Word) * wordsPerRead + scoringBytesPerPair * referencesPerRead;
 
-	if (fswm_params::g_assignmentMode != "APPLES") {
-		tree.write_jplace_data_end();
+	double referenceBytes = genomeManager.get_ExternalBuckets() == nullptr ? (double) genomeManager.get_wordCount() * sizeof(Word) : 0;
+	double ceiling = params.memoryLimit;
+	if (ceiling == 0) {
+		ceiling = (double) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGE_SIZE) / 2;
 	}
+	double budget = params.autoReadBlockSize ? std::max(ceiling / 4, ceiling - referenceBytes) : ceiling / 4;
 
-	if (fswm_params::g_assignmentMode == "APPLES") {
-		int res = std::system(("run_apples.py -t " + fswm_params::g_reftreefname + " -d " + fswm_params::g_outfoldername +
-					"scoring_table.txt -o " + fswm_params::g_outfoldername + fswm_params::g_outjplacename).c_str());
-		if (res != 0) {
-			std::cout << "Apples did not run properly." << std::endl;
-			exit (EXIT_FAILURE);
-		}
+	double readBlockSize = params.readBlockSize;
+	if (params.autoReadBlockSize) {
+		double scanBlockSize = std::max(genomeManager.get_wordCount() / wordsPerRead, minReadBlockSize);
+		readBlockSize = std::min(scanBlockSize, std::ceil((double) readManager.get_readCount() / concurrency));
 	}
-}
 
-void Placement::create_output_files() {
-	std::ofstream assignmentJPlaceFile;
-	assignmentJPlaceFile.open(fswm_params::g_outfoldername + fswm_params::g_outjplacename);
-	assignmentJPlaceFile.close();
+	// Every partition scans all reference buckets, so partitions are never made smaller than minReadBlockSize
+	double minBlockSize = std::min({readBlockSize, minReadBlockSize, (double) readManager.get_readCount()});
+	if (budget / concurrency / bytesPerRead < minBlockSize) {
+		concurrency = std::max(1, (int) (budget / bytesPerRead / minBlockSize));
+	}
+	if (budget / bytesPerRead < minBlockSize) {
+		std::cerr << "ERROR: Partitions of " << (uint32_t) minBlockSize << " queries need about "
+				  << (uint64_t) (minBlockSize * bytesPerRead / 1024) + 1 << "K, more than the memory available for them ("
+				  << (uint64_t) (budget / 1024) << "K). Please increase --memory-limit." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	double maxReadBlockSize = std::max(budget / concurrency / bytesPerRead, minBlockSize);
+	if (!params.autoReadBlockSize and maxReadBlockSize < readBlockSize) {
+		std::cout << "\tReducing read block size from " << params.readBlockSize << " to "
+				  << (uint32_t) maxReadBlockSize << " to stay within the memory limit." << std::endl;
+	}
+	readBlockSize = std::max(std::min({readBlockSize, maxReadBlockSize, 200000.0}), 1.0);
+	readManager.set_readBlockSize(readBlockSize);
+	concurrency = std::min(concurrency, (int) readManager.get_partitions());
 
-	if (fswm_params::g_writeHistogram) {
-		std::ofstream histogramFile;
-		histogramFile.open(fswm_params::g_outfoldername + "histogram.txt");
-		histogramFile.close();
+	if (params.autoReadBlockSize) {
+		std::cout << "\tRead block size " << readManager.get_readBlockSize() << ", " << readManager.get_partitions()
+				  << " partitions with " << concurrency << " in parallel." << std::endl;
 	}
+	Profiler::set_info("read_block_size_mode", params.autoReadBlockSize ? "auto" : "fixed");
+	Profiler::set_info("concurrent_partitions", std::to_string(concurrency));
+	Profiler::set_info("estimated_words_per_query", std::to_string((uint64_t) wordsPerRead));
+	Profiler::set_info("estimated_partition_bytes", std::to_string((uint64_t) (readManager.get_readBlockSize() * bytesPerRead)));
+	Profiler::set_info("memory_ceiling", std::to_string((uint64_t) ceiling));
+	return concurrency;
 }
@@ -0,0 +1,280 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <omp.h>
+#include <iostream>
+#include <fstream>
+#include "PlacementEngine.h"
+#include "Placement.h"
+#include "Algorithms.h"
+#include "Scoring.h"
+#include "GlobalParameters.h"
+#include "Profiler.h"
+#include "NumaTopology.h"
+
+PlacementEngine::PlacementEngine(const Parameters &parameters) : params(parameters) {
+	if (!params.indexfoldername.empty()) {
+		// Patterns and parameters of the words of the references are fixed by the index
+		ProfilerTimer timer(Profiler::REFERENCE_PARSING);
+		referenceIndex.reset(new ReferenceIndex());
+		if (!referenceIndex->load(params.indexfoldername)) {
+			std::cerr << "ERROR: " << params.indexfoldername << " is not a valid index of this version of appspam." << std::endl;
+			exit (EXIT_FAILURE);
+		}
+		referenceIndex->apply_parameters(params);
+		patterns = referenceIndex->get_patterns();
+	}
+	else {
+		ProfilerTimer timer(Profiler::PATTERN_OPTIMIZATION);
+		patterns = Placement::create_patterns(params);
+	}
+
+	if (params.verbose) { std::cout << "-> Pattern size : " << patterns.size() << std::endl; }
+
+	for (int i = 0; i < params.numPatterns; i++) {
+		Seed seed(params.weight, params.spaces);
+		seed.generate_pattern(patterns[i], params.verbose);
+		seeds.push_back(seed);
+	}
+}
+
+void PlacementEngine::load_references() {
+	if (references_loaded()) {
+		return;
+	}
+
+	// Read genomes, create spaced words and organize BucketManagers, or take them from the index
+	if (referenceIndex) {
+		genomeManager.reset(new GenomeManager(*referenceIndex, registry, params));
+		referenceIndex.reset();
+	}
+	else {
+		genomeManager.reset(new GenomeManager(params.genomesfname, seeds, registry, params));
+	}
+
+	if (params.writeIDs) { GlobalParameters::write_seq_ids_to_file(params.outfoldername, registry); };
+
+	tree.reset(new Tree(params.reftreefname, registry, params));		// Read and create reference tree
+
+	// Numbers the edges of the tree for placements
+	jplaceTree = tree->get_newick_str(true);
+}
+
+/**
+ * Only concurrency threads (bounded by memory) create partitions, taking the next
+ * one whenever they are done. Bucket joins and APPLES placements of a partition
+ * are tasks, which all other threads of the team pick up, so few large partitions
+ * at the end of a batch are still worked on by all threads.
+ */
+void PlacementEngine::place_partitions(ReadManager &readManager, ScoreHistogram *histogram, ScoringWriter *scoringWriter,
+		std::function<void(Scoring&)> finish_partition) {
+	int concurrency = Placement::plan_partitions(readManager, *genomeManager, params);
+	int partitions = readManager.get_partitions();
+	int nextPartition = 0;
+
+	// Compare buckets of reads and genomes
+	std::cout << "-> Comparing reads and genomes." << std::endl;
+	bool pinThreads = params.numaMode != "off" and NumaTopology::get_nodeCount() > 1;
+	#pragma omp parallel num_threads(params.threads)
+	{
+	if (pinThreads) {
+		NumaTopology::pin_thread(NumaTopology::get_thread_node(omp_get_thread_num(), omp_get_num_threads()));
+	}
+
+	while (omp_get_thread_num() < concurrency) {
+		int currentPartition;
+		#pragma omp atomic capture
+		currentPartition = nextPartition++;
+		if (currentPartition >= partitions) {
+			break;
+		}
+
+		if (params.verbose) { std::cout << "-> Starting partition " << currentPartition << std::endl; }
+
+		// Reads and reference registries are only read, partitions keep their own read names
+		BucketManager bucketManagerReads;
+		Scoring fswm_distances = Scoring();
+		std::vector<seq_id_t> readIDs = readManager.get_partition_BucketManager(currentPartition, seeds, bucketManagerReads,
+				fswm_distances.readNames, &fswm_distances.duplicateNames);
+		fswm_distances.firstReadID = readIDs.front();
+
+		Profiler::add_count(Profiler::PARTITIONS, 1);
+
+		// Each partition counts scores in its own histogram, merged below
+		std::unique_ptr<ScoreHistogram> partitionHistogram;
+		if (histogram != nullptr) {
+			partitionHistogram.reset(new ScoreHistogram(params));
+		}
+
+		// Reference words are shared by all partitions and only read, either in memory or streamed from disk
+		if (genomeManager->get_ExternalBuckets() != nullptr) {
+			Algorithms::fswm_complete(*genomeManager->get_ExternalBuckets(), bucketManagerReads, fswm_distances, params, partitionHistogram.get());
+		}
+		else {
+			Algorithms::fswm_complete_tasks(*genomeManager, bucketManagerReads, fswm_distances, params, partitionHistogram.get());
+		}
+
+		// Distances and placements only depend on this partition and the (read-only) reference tree
+		std::cout << "\t-> Read partition " << currentPartition << ": Calculating distances." << std::endl;
+		{
+			ProfilerTimer timer(Profiler::DISTANCE_CALCULATION);
+			fswm_distances.calculate_fswm_distances(params);
+		}
+		std::cout << "\t-> Read partition " << currentPartition << ": Placing reads in tree." << std::endl;
+		{
+			ProfilerTimer timer(Profiler::TREE_PLACEMENT);
+			fswm_distances.phylogenetic_placement(readIDs, *tree, params);
+		}
+
+		if (scoringWriter != nullptr) {
+			scoringWriter->write_rows(fswm_distances, readIDs);
+		}
+
+		// Output of placements and histogram is shared by all partitions
+		#pragma omp critical
+		{
+			finish_partition(fswm_distances);
+
+			if (partitionHistogram) {
+				histogram->merge(*partitionHistogram);
+			}
+		}
+	}
+
+	// All tasks are done after the barrier, so no thread needs its node anymore
+	if (pinThreads) {
+		#pragma omp barrier
+		NumaTopology::unpin_thread();
+	}
+	}
+}
+
+/**
+ * Names of the queries are only kept by their partitions. Batches after the
+ * references are loaded all reuse the IDs after the tree nodes, so a long-lived
+ * engine does not grow with the number of placed queries.
+ */
+std::vector<QueryPlacement> PlacementEngine::place(const std::vector<std::pair<std::string, std::string>> &queries) {
+	bool reuseIDs = references_loaded();
+	seq_id_t lastID = registry.get_lastSeqID();
+	ReadManager readManager(queries, registry, params);
+	load_references();
+
+	std::vector<Sequence> &reads = readManager.get_reads();
+	std::vector<std::vector<PlacementRecord>> readPlacements(reads.size());
+	std::vector<QueryPlacement> placements(queries.size());
+	for (size_t i = 0; i < queries.size(); i++) {
+		placements[i].name = queries[i].first.substr(0, queries[i].first.find(' '));
+	}
+	if (reads.empty()) {
+		return placements;
+	}
+
+	// Sequence IDs of a batch are consecutive
+	seq_id_t firstID = reads[0].get_seqID();
+	place_partitions(readManager, nullptr, nullptr, [&](Scoring &fswm_distances) {
+		for (auto const &read : fswm_distances.readAssignment) {
+			readPlacements[read.first - firstID] = tree->get_placement_records(read, fswm_distances.scoringMap,
+					fswm_distances.branchLengths, fswm_distances.weightedPlacements);
+		}
+	});
+
+	// Identical queries share the placements of their read (--dereplicate)
+	for (size_t i = 0; i < queries.size(); i++) {
+		placements[i].placements = readPlacements[readManager.get_queryRead(i)];
+	}
+
+	if (reuseIDs) {
+		registry.set_lastSeqID(lastID);
+	}
+	return placements;
+}
+
+void PlacementEngine::place_file(std::string readsfname) {
+	std::cout << "-> Reading sequences." << std::endl;
+	// Read reads
+	ReadManager	readManager(readsfname, registry, params);
+	load_references();
+
+	if (params.writeIDs) { GlobalParameters::write_read_ids_to_file(params.outfoldername, readManager.get_reads()); };
+
+	PlacementWriter placementWriter(PlacementWriter::get_output_filename(params.outfoldername + params.outjplacename,
+			params.outputFormat), params.outputFormat);
+	{
+		ProfilerTimer timer(Profiler::JPLACE_WRITING);
+		tree->write_jplace_data_beginning(placementWriter);
+	}
+
+	std::unique_ptr<ScoringWriter> scoringWriter;
+	if (params.writeScoring and params.scoresFormat == "binary") {
+		scoringWriter.reset(new ScoringWriter(params.outfoldername + "scoring.bscore", readManager.get_reads(), registry,
+				params.defaultDistance));
+	}
+	else if (params.writeScoring) {
+		std::ofstream results;
+		results.open(params.outfoldername + "scoring_table.txt");
+
+		for (auto genome : registry.get_genomes()) {		// Write columns names (references to file)
+			results << "\t" << genome.second;
+		}
+		results << "\n";
+		results.close();
+
+		results.open(params.outfoldername + "scoring_list.txt");
+		results.close();
+	}
+
+	ScoreHistogram histogram(params);
+
+	place_partitions(readManager, params.writeHistogram ? &histogram : nullptr, scoringWriter.get(), [&](Scoring &fswm_distances) {
+		{
+			ProfilerTimer timer(Profiler::JPLACE_WRITING);
+			fswm_distances.write_placement_to_jplace(*tree, placementWriter);
+		}
+
+		if (params.writeScoring and !scoringWriter) {
+			fswm_distances.write_scoring_to_file(params);
+			fswm_distances.write_scoring_to_file_as_table(registry, params);
+		}
+	});
+
+	{
+		ProfilerTimer timer(Profiler::JPLACE_WRITING);
+		tree->write_jplace_data_end(placementWriter);
+	}
+
+	if (params.writeHistogram) {
+		histogram.write_to_file(params.outfoldername + "histogram.txt");
+	}
+
+	if (params.writeReport) {
+		Profiler::set_info("mode", params.assignmentMode);
+		Profiler::set_info("read_block_size", std::to_string(readManager.get_readBlockSize()));
+		Profiler::set_info("patterns", std::to_string(params.numPatterns));
+		Profiler::set_info("pattern_seed", std::to_string(params.patternSeed));
+		if (!params.patternfname.empty()) {
+			Profiler::set_info("pattern_file", params.patternfname);
+		}
+		if (params.memoryLimit > 0) {
+			Profiler::set_info("memory_limit", std::to_string(params.memoryLimit));
+			Profiler::set_info("spilled_runs", std::to_string(genomeManager->get_ExternalBuckets() != nullptr ?
+					genomeManager->get_ExternalBuckets()->get_runCount() : 0));
+		}
+		Profiler::set_info("weight", std::to_string(params.weight));
+		Profiler::set_info("dont_cares", std::to_string(params.spaces));
+		Profiler::write_report(params.outfoldername + "run_report.json");
+	}
+}
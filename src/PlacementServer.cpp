@@ -0,0 +1,343 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <omp.h>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "PlacementServer.h"
+#include "GlobalParameters.h"
+
+namespace {
+	// Requests larger than this are rejected instead of read into memory
+	const size_t maxRequestBytes = 1ULL << 30;
+
+	volatile sig_atomic_t stopRequested = 0;
+
+	void request_stop(int) {
+		stopRequested = 1;
+	}
+
+	void send_all(int connection, const std::string &message) {
+		size_t sent = 0;
+		while (sent < message.size()) {
+			ssize_t n = send(connection, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+			if (n < 0 and errno == EINTR) {
+				continue;
+			}
+			if (n <= 0) {
+				return;		// Client is gone, nothing left to do
+			}
+			sent += n;
+		}
+	}
+
+	void print_serve_help() {
+		std::cout << R""""(
+Start a placement server with:
+	./appspam serve -i <index> --socket <socket> [optional parameters]
+	./appspam serve -s <references> -t <tree> --socket <socket> [optional parameters]
+------------------------------------------------------------
+References and tree are loaded once and kept in memory. Clients connect to the
+Unix domain socket, send queries in fasta format and close their writing side,
+e.g. with
+	socat - UNIX-CONNECT:/tmp/appspam.sock < query.fasta
+The answer is {"placements": [...]} with one JPlace placement per placed query,
+or {"error": "..."}. The request TREE returns the reference tree with the edge
+numbers used in the placements. Stop the server with SIGINT or SIGTERM.
+
+Parameters of the server:
+        --socket            Path of the Unix domain socket to create.
+        --workers           Number of connections handled in parallel (default 4).
+        --queue             Number of accepted connections waiting for a worker
+                            (default 16). Further clients wait until there is room.
+
+All parameters of ./appspam -h except -q and the output files can be used, e.g.
+-w, -d, -p, -m, --threads, --top-k and --placements.
+)"""";
+	}
+}
+
+PlacementServer::PlacementServer(PlacementEngine &engine, std::string socketfname, uint32_t workers, uint32_t queueSize)
+	: engine(engine), socketfname(socketfname), workers(workers), queueSize(queueSize), listenSocket(-1), stopping(false) {
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketfname.size() >= sizeof(address.sun_path)) {
+		std::cerr << "ERROR: Socket path " << socketfname << " is too long." << std::endl;
+		exit (EXIT_FAILURE);
+	}
+	strncpy(address.sun_path, socketfname.c_str(), sizeof(address.sun_path) - 1);
+
+	// Remove the socket of a previous server, but never any other file
+	struct stat socketStat;
+	if (lstat(socketfname.c_str(), &socketStat) == 0) {
+		if (!S_ISSOCK(socketStat.st_mode)) {
+			std::cerr << "ERROR: " << socketfname << " exists and is not a socket." << std::endl;
+			exit (EXIT_FAILURE);
+		}
+		unlink(socketfname.c_str());
+	}
+
+	listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenSocket < 0 or bind(listenSocket, (sockaddr*) &address, sizeof(address)) != 0
+			or listen(listenSocket, queueSize) != 0) {
+		std::cerr << "ERROR: Could not listen on socket " << socketfname << ": " << strerror(errno) << std::endl;
+		exit (EXIT_FAILURE);
+	}
+}
+
+PlacementServer::~PlacementServer() {
+	if (listenSocket >= 0) {
+		close(listenSocket);
+		unlink(socketfname.c_str());
+	}
+}
+
+/**
+ * Connections are only accepted while the queue has room. poll wakes up
+ * regularly to notice SIGINT and SIGTERM. Queued connections are still
+ * answered when the server stops.
+ */
+void PlacementServer::run() {
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = request_stop;
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+
+	std::vector<std::thread> pool;
+	for (uint32_t i = 0; i < workers; i++) {
+		pool.push_back(std::thread(&PlacementServer::work, this));
+	}
+
+	std::cout << "-> Listening on " << socketfname << std::endl;
+	while (!stopRequested) {
+		{
+			std::unique_lock<std::mutex> lock(connectionsMutex);
+			if (!connectionsNotFull.wait_for(lock, std::chrono::milliseconds(200),
+					[&]() { return connections.size() < queueSize; })) {
+				continue;
+			}
+		}
+
+		pollfd listenPoll = { listenSocket, POLLIN, 0 };
+		if (poll(&listenPoll, 1, 200) <= 0) {
+			continue;
+		}
+		int connection = accept(listenSocket, nullptr, nullptr);
+		if (connection < 0) {
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(connectionsMutex);
+		connections.push_back(connection);
+		connectionsNotEmpty.notify_one();
+	}
+
+	std::cout << "-> Stopping server." << std::endl;
+	{
+		std::lock_guard<std::mutex> lock(connectionsMutex);
+		stopping = true;
+	}
+	connectionsNotEmpty.notify_all();
+	for (auto &worker : pool) {
+		worker.join();
+	}
+}
+
+void PlacementServer::work() {
+	while (true) {
+		int connection;
+		{
+			std::unique_lock<std::mutex> lock(connectionsMutex);
+			connectionsNotEmpty.wait(lock, [&]() { return stopping or !connections.empty(); });
+			if (connections.empty()) {
+				return;
+			}
+			connection = connections.front();
+			connections.pop_front();
+		}
+		connectionsNotFull.notify_one();
+
+		handle_connection(connection);
+		close(connection);
+	}
+}
+
+/**
+ * Read the request until the client closes its writing side. Clients that do
+ * not send anything for a minute are dropped so they cannot block a worker.
+ */
+void PlacementServer::handle_connection(int connection) {
+	timeval timeout = { 60, 0 };
+	setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	std::string request;
+	char buffer[1 << 16];
+	while (true) {
+		ssize_t n = recv(connection, buffer, sizeof(buffer), 0);
+		if (n < 0 and errno == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			return;
+		}
+		if (n == 0) {
+			break;
+		}
+		if (request.size() + n > maxRequestBytes) {
+			send_all(connection, "{\"error\": \"Request is larger than " + std::to_string(maxRequestBytes) + " bytes.\"}\n");
+			return;
+		}
+		request.append(buffer, n);
+	}
+
+	send_all(connection, answer_request(request));
+}
+
+std::string PlacementServer::answer_request(const std::string &request) {
+	std::istringstream requestStream(request);
+	std::vector<std::pair<std::string, std::string>> queries;
+	std::string line;
+	bool tree = false;
+	while (std::getline(requestStream, line)) {
+		if (!line.empty() and line.back() == '\r') {
+			line.pop_back();
+		}
+		if (line.empty()) {
+			continue;
+		}
+		if (queries.empty() and line == "TREE") {
+			tree = true;
+		}
+		else if (line[0] == '>') {
+			queries.push_back(std::make_pair(line.substr(1), std::string()));
+		}
+		else if (!queries.empty() and !tree) {
+			queries.back().second += line;
+		}
+		else {
+			return "{\"error\": \"Request is neither fasta nor TREE.\"}\n";
+		}
+	}
+	if (tree) {
+		if (!queries.empty()) {
+			return "{\"error\": \"Request is neither fasta nor TREE.\"}\n";
+		}
+		return "{\"tree\": \"" + PlacementWriter::json_escape(engine.get_jplace_tree()) + "\"}\n";
+	}
+
+	std::vector<QueryPlacement> placements;
+	{
+		std::lock_guard<std::mutex> lock(engineMutex);
+		placements = engine.place(queries);
+	}
+
+	std::string answer = "{\"placements\": [\n";
+	bool first = true;
+	for (auto const &query : placements) {
+		if (query.placements.empty()) {
+			continue;
+		}
+		if (!first) {
+			answer += ",";
+		}
+		first = false;
+		answer += PlacementWriter::format_jplace_placement(query.name, query.placements, 1);
+	}
+	answer += "]}\n";
+	return answer;
+}
+
+/**
+ * Options of the server are removed from the arguments, all other arguments
+ * are parsed as for a placement run.
+ */
+int PlacementServer::serve_command(int argc, char *argv[]) {
+	std::string socketfname = "";
+	uint32_t workers = 4;
+	uint32_t queueSize = 16;
+
+	std::vector<char*> arguments(1, argv[0]);
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		std::string value = "";
+		std::string option = argument.substr(0, argument.find('='));
+		if (option == "--socket" or option == "--workers" or option == "--queue") {
+			if (argument.find('=') != std::string::npos) {
+				value = argument.substr(argument.find('=') + 1);
+			}
+			else if (i + 1 < argc) {
+				value = argv[++i];
+			}
+			else {
+				std::cerr << "ERROR: " << option << " requires an argument." << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (argument == "-h" or argument == "--help") {
+			print_serve_help();
+			return EXIT_SUCCESS;
+		}
+		else {
+			arguments.push_back(argv[i]);
+			continue;
+		}
+
+		if (option == "--socket") {
+			socketfname = value;
+		}
+		else if (atoi(value.c_str()) < 1) {
+			std::cerr << "ERROR: " << option << " must be a positive number." << std::endl;
+			return EXIT_FAILURE;
+		}
+		else if (option == "--workers") {
+			workers = atoi(value.c_str());
+		}
+		else {
+			queueSize = atoi(value.c_str());
+		}
+	}
+	if (socketfname.empty()) {
+		print_serve_help();
+		return EXIT_SUCCESS;
+	}
+	arguments.push_back(nullptr);
+
+	GlobalParameters::parse_parameters(arguments.size() - 1, arguments.data());
+	GlobalParameters::check_parameters(false);
+	if (fswm_params::g_verbose) {GlobalParameters::print_to_console(); };
+
+	omp_set_dynamic(0);
+	omp_set_num_threads(fswm_params::g_threads);
+
+	PlacementEngine placementEngine(GlobalParameters::get_parameters());
+	placementEngine.load_references();
+
+	PlacementServer placementServer(placementEngine, socketfname, workers, queueSize);
+	placementServer.run();
+	return EXIT_SUCCESS;
+}
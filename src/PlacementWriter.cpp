@@ -0,0 +1,370 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <iostream>
+#include <cstring>
+#include <memory>
+#include "PlacementWriter.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Placements are collected in memory and written in blocks of this size
+static const size_t writeBufferSize = 1 << 22;
+
+PlacementWriter::PlacementWriter(std::string filename, std::string format) {
+	this->format = format;
+	this->filename = filename;
+	this->file = nullptr;
+	this->gzStream = nullptr;
+	this->first = true;
+	buffer.reserve(writeBufferSize + (1 << 16));
+
+	if (!format_supported(format)) {
+		std::cerr << "ERROR: Output format is not supported by this build: " << format << std::endl;
+		exit (EXIT_FAILURE);
+	}
+
+	if (format == "jplace.gz") {
+#ifdef HAVE_ZLIB
+		gzStream = gzopen(filename.c_str(), "wb");
+		if (gzStream != nullptr) {
+			gzbuffer((gzFile) gzStream, 1 << 20);
+		}
+#endif
+	}
+	else {
+		file = fopen(filename.c_str(), "wb");
+	}
+
+	if (file == nullptr and gzStream == nullptr) {
+		std::cerr << "ERROR: Could not open output file: " << filename << std::endl;
+		exit (EXIT_FAILURE);
+	}
+}
+
+PlacementWriter::~PlacementWriter() {
+	flush_buffer();
+	close_file();
+}
+
+bool PlacementWriter::format_supported(std::string format) {
+	if (format == "jplace" or format == "binary") {
+		return true;
+	}
+#ifdef HAVE_ZLIB
+	if (format == "jplace.gz") {
+		return true;
+	}
+#endif
+	return false;
+}
+
+std::string PlacementWriter::get_output_filename(std::string filename, std::string format) {
+	std::string suffix = "";
+	if (format == "jplace.gz") {
+		suffix = ".gz";
+	}
+	else if (format == "binary") {
+		suffix = ".bplace";
+	}
+
+	if (filename.size() >= suffix.size() and filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0) {
+		return filename;
+	}
+	return filename + suffix;
+}
+
+void PlacementWriter::write_raw(const char *data, size_t size) {
+	buffer.append(data, size);
+	if (buffer.size() >= writeBufferSize) {
+		flush_buffer();
+	}
+}
+
+void PlacementWriter::write_string(const std::string &str) {
+	write_raw(str.data(), str.size());
+}
+
+void PlacementWriter::write_uint32(uint32_t value) {
+	write_raw(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void PlacementWriter::write_float(float value) {
+	write_raw(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void PlacementWriter::flush_buffer() {
+	if (buffer.empty()) {
+		return;
+	}
+	bool written = true;
+	if (file != nullptr) {
+		written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+	}
+#ifdef HAVE_ZLIB
+	if (gzStream != nullptr) {
+		written = gzwrite((gzFile) gzStream, buffer.data(), buffer.size()) == (int) buffer.size();
+	}
+#endif
+	if (!written) {
+		write_failed();
+	}
+	buffer.clear();
+}
+
+/** Buffered data only reaches the disk on close, so its result is checked as well. */
+void PlacementWriter::close_file() {
+	bool closed = true;
+	if (file != nullptr) {
+		closed = fclose(file) == 0;
+		file = nullptr;
+	}
+#ifdef HAVE_ZLIB
+	if (gzStream != nullptr) {
+		closed = gzclose((gzFile) gzStream) == Z_OK;
+		gzStream = nullptr;
+	}
+#endif
+	if (!closed) {
+		write_failed();
+	}
+}
+
+/** A truncated output file must not look like a successful run. */
+void PlacementWriter::write_failed() {
+	std::cerr << "ERROR: Could not write output file " << filename << " (disk full?)." << std::endl;
+	exit (EXIT_FAILURE);
+}
+
+/** Write JPlace version, fields, metadata and tree, or the header of the binary format. */
+void PlacementWriter::write_beginning(const std::string &metadata, const std::string &tree) {
+	if (format == "binary") {
+		write_raw("APPSPAMP", 8);
+		write_uint32(byteOrderMark);
+		write_uint32(binaryVersion);
+		write_uint32(metadata.size());
+		write_string(metadata);
+		write_uint32(tree.size());
+		write_string(tree);
+		return;
+	}
+
+	write_string("{\n\t\"version\":3,\n\t"
+		"\"fields\":[\"edge_num\",\"distal_length\",\"pendant_length\",\"like_weight_ratio\",\"likelihood\"],\n"
+		"\t\"metadata\":{\n");
+	write_string(metadata);
+	write_string("\t},\n\t\"tree\":\"");
+	write_string(json_escape(tree));
+	write_string("\",\n"
+		"\t\"placements\":\n"
+		"\t[\n");
+}
+
+/** Write all placements of one query. */
+void PlacementWriter::write_placement(uint32_t queryIndex, const std::vector<std::string> &names,
+		const std::vector<PlacementRecord> &placements, uint32_t mass) {
+	if (format == "binary") {
+		for (auto const &name : names) {
+			write_raw("N", 1);
+			write_uint32(queryIndex);
+			write_uint32(mass);
+			write_uint32(name.size());
+			write_string(name);
+		}
+		for (auto const &placement : placements) {
+			write_raw("P", 1);
+			write_uint32(queryIndex);
+			write_uint32(placement.edge);
+			write_float(placement.distal_length);
+			write_float(placement.pendant_length);
+			write_float(placement.weight);
+		}
+		return;
+	}
+
+	if (!first) {
+		write_raw(",", 1);
+	}
+	first = false;
+	write_string(format_jplace_placement(names, placements, mass));
+}
+
+/** JPlace placement object of one or several queries, as written in the placements array. */
+std::string PlacementWriter::format_jplace_placement(const std::vector<std::string> &names,
+		const std::vector<PlacementRecord> &placements, uint32_t mass) {
+	std::string entry = "\t\t{\n"
+		"\t\t\t\"p\":\n"
+		"\t\t\t[";
+	for (size_t i = 0; i < placements.size(); i++) {
+		if (i > 0) {
+			entry += ",";
+		}
+		entry += "[" + std::to_string(placements[i].edge) + "," + std::to_string(placements[i].distal_length) + ","
+				+ std::to_string(placements[i].pendant_length) + ","
+				+ (placements[i].weight == 1 ? "1" : std::to_string(placements[i].weight)) + ",1]";
+	}
+	entry += "],\n"
+		"\t\t\t\"nm\":\n"
+		"\t\t\t[";
+	for (size_t i = 0; i < names.size(); i++) {
+		entry += (i > 0 ? ", [\"" : "[\"") + json_escape(names[i]) + "\", " + std::to_string(mass) + "]";
+	}
+	entry += "]\n"
+		"\t\t}\n";
+	return entry;
+}
+
+/** Quotes and backslashes are escaped, other control characters written as \u00XX. */
+std::string PlacementWriter::json_escape(const std::string &str) {
+	std::string escaped;
+	for (char c : str) {
+		if (c == '"' or c == '\\') {
+			escaped += '\\';
+			escaped += c;
+		}
+		else if ((unsigned char) c < 0x20) {
+			char code[7];
+			snprintf(code, sizeof(code), "\\u%04x", (unsigned char) c);
+			escaped += code;
+		}
+		else {
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+/** Write closing brackets after placement data, flush everything to file and close it. */
+void PlacementWriter::write_end() {
+	if (format != "binary") {
+		write_string("\t]\n"
+			"}");
+	}
+	flush_buffer();
+	close_file();
+}
+
+/**
+ * Convert binary placement file to JPlace.
+ */
+bool PlacementWriter::convert_binary(std::string binaryfname, std::string outfname, std::string format) {
+	FILE *in = fopen(binaryfname.c_str(), "rb");
+	if (in == nullptr) {
+		std::cerr << "ERROR: Could not open binary placement file: " << binaryfname << std::endl;
+		return false;
+	}
+
+	char magic[8];
+	uint32_t mark = 0;
+	uint32_t version = 0;
+	if (fread(magic, 1, 8, in) != 8 or std::memcmp(magic, "APPSPAMP", 8) != 0 or fread(&mark, sizeof(mark), 1, in) != 1) {
+		std::cerr << "ERROR: Not a binary placement file of this version: " << binaryfname << std::endl;
+		fclose(in);
+		return false;
+	}
+	if (mark == __builtin_bswap32(byteOrderMark)) {
+		std::cerr << "ERROR: Binary placement file was written on a machine with different byte order: " << binaryfname << std::endl;
+		fclose(in);
+		return false;
+	}
+	if (mark != byteOrderMark or fread(&version, sizeof(version), 1, in) != 1 or version != binaryVersion) {
+		std::cerr << "ERROR: Not a binary placement file of this version: " << binaryfname << std::endl;
+		fclose(in);
+		return false;
+	}
+
+	auto read_string = [in](std::string &str) {
+		uint32_t size = 0;
+		if (fread(&size, sizeof(size), 1, in) != 1) {
+			return false;
+		}
+		str.resize(size);
+		return size == 0 or fread(&str[0], 1, size, in) == size;
+	};
+
+	std::string metadata, tree;
+	if (!read_string(metadata) or !read_string(tree)) {
+		std::cerr << "ERROR: Binary placement file is truncated: " << binaryfname << std::endl;
+		fclose(in);
+		return false;
+	}
+
+	std::unique_ptr<PlacementWriter> writer(new PlacementWriter(outfname, format));
+	writer->write_beginning(metadata, tree);
+
+	std::string name;
+	std::vector<std::string> names;
+	uint32_t queryIndex = 0;
+	uint32_t mass = 1;
+	std::vector<PlacementRecord> placements;
+	bool hasQuery = false;
+	std::string error = "";
+	char tag;
+
+	while (fread(&tag, 1, 1, in) == 1) {
+		if (tag == 'N') {
+			uint32_t index, nameMass;
+			if (fread(&index, sizeof(index), 1, in) != 1 or fread(&nameMass, sizeof(nameMass), 1, in) != 1 or !read_string(name)) {
+				error = "Binary placement file is truncated: ";
+				break;
+			}
+			// Further names of the same query directly follow the first one
+			if (hasQuery and index == queryIndex and placements.empty()) {
+				names.push_back(name);
+				continue;
+			}
+			if (hasQuery) {
+				writer->write_placement(queryIndex, names, placements, mass);
+			}
+			placements.clear();
+			names.assign(1, name);
+			queryIndex = index;
+			mass = nameMass;
+			hasQuery = true;
+		}
+		else if (tag == 'P') {
+			uint32_t index, edge;
+			float values[3];
+			if (fread(&index, sizeof(index), 1, in) != 1 or fread(&edge, sizeof(edge), 1, in) != 1 or
+					fread(values, sizeof(float), 3, in) != 3) {
+				error = "Binary placement file is truncated: ";
+				break;
+			}
+			placements.push_back(PlacementRecord {edge, values[0], values[1], values[2]});
+		}
+		else {
+			error = "Unknown record in binary placement file: ";
+			break;
+		}
+	}
+	fclose(in);
+
+	// A partial file would not be valid JPlace, so nothing is kept
+	if (!error.empty()) {
+		std::cerr << "ERROR: " << error << binaryfname << std::endl;
+		std::string writtenfname = writer->get_filename();
+		writer.reset();
+		std::remove(writtenfname.c_str());
+		return false;
+	}
+	if (hasQuery) {
+		writer->write_placement(queryIndex, names, placements, mass);
+	}
+
+	writer->write_end();
+	return true;
+}
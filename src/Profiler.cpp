@@ -0,0 +1,119 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <time.h>
+#include <sys/resource.h>
+#include "Profiler.h"
+#include "GlobalParameters.h"
+#include "PlacementWriter.h"
+
+std::chrono::steady_clock::time_point Profiler::start = std::chrono::steady_clock::now();
+std::atomic<uint64_t> Profiler::phaseCalls[Profiler::NUM_PHASES];
+std::atomic<uint64_t> Profiler::phaseWall[Profiler::NUM_PHASES];
+std::atomic<uint64_t> Profiler::phaseCpu[Profiler::NUM_PHASES];
+std::atomic<uint64_t> Profiler::counters[Profiler::NUM_COUNTERS];
+
+static const char *phaseNames[Profiler::NUM_PHASES] = {
+	"pattern_optimization", "reference_parsing", "query_parsing", "fill_buckets", "bucket_sort_group",
+	"bucket_spill", "numa_distribution", "bucket_join", "distance_calculation", "tree_placement", "jplace_writing" };
+
+static const char *counterNames[Profiler::NUM_COUNTERS] = {
+	"partitions", "candidate_pairs", "filtered_matches", "large_groups", "skipped_pairs" };
+
+// Words per bucket and additional information are rarely updated and guarded by one mutex
+static std::mutex infoMutex;
+static std::map<minimizer_t, std::pair<uint64_t, uint64_t>> bucketWords;
+static std::map<std::string, std::string> infos;
+
+uint64_t Profiler::thread_cpu_time() {
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Reference words are the same in every partition, query words are summed over partitions.
+ * Nothing is collected (and no lock taken) unless a report is written.
+ */
+void Profiler::add_bucket_words(minimizer_t minimizer, uint64_t referenceWords, uint64_t queryWords) {
+	if (!fswm_params::g_writeReport) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(infoMutex);
+	std::pair<uint64_t, uint64_t> &words = bucketWords[minimizer];
+	words.first = referenceWords;
+	words.second += queryWords;
+}
+
+void Profiler::set_info(std::string key, std::string value) {
+	std::lock_guard<std::mutex> lock(infoMutex);
+	infos[key] = value;
+}
+
+void Profiler::write_report(std::string filename) {
+	std::lock_guard<std::mutex> lock(infoMutex);
+
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	double cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+	std::ofstream report(filename);
+	report << "{\n";
+	report << "\t\"threads\": " << fswm_params::g_threads << ",\n";
+	report << "\t\"wall_seconds\": " << wallSeconds << ",\n";
+	report << "\t\"cpu_seconds\": " << cpuSeconds << ",\n";
+	report << "\t\"peak_rss_kb\": " << usage.ru_maxrss << ",\n";
+
+	report << "\t\"phases\": {\n";
+	for (int i = 0; i < NUM_PHASES; i++) {
+		report << "\t\t\"" << phaseNames[i] << "\": {\"calls\": " << phaseCalls[i]
+			   << ", \"wall_seconds\": " << phaseWall[i] / 1e9
+			   << ", \"cpu_seconds\": " << phaseCpu[i] / 1e9 << "}" << (i + 1 < NUM_PHASES ? ",\n" : "\n");
+	}
+	report << "\t},\n";
+
+	report << "\t\"counters\": {\n";
+	for (int i = 0; i < NUM_COUNTERS; i++) {
+		report << "\t\t\"" << counterNames[i] << "\": " << counters[i] << (i + 1 < NUM_COUNTERS ? ",\n" : "\n");
+	}
+	report << "\t},\n";
+
+	// Join throughput per thread; compare runs (e.g. --numa off and replicate) by it, remote memory lowers it
+	double joinSeconds = phaseWall[BUCKET_JOIN] / 1e9;
+	report << "\t\"join_pairs_per_thread_second\": " << (joinSeconds > 0 ? counters[CANDIDATE_PAIRS] / joinSeconds : 0) << ",\n";
+
+	report << "\t\"buckets\": [\n";
+	size_t i = 0;
+	for (auto const &bucket : bucketWords) {
+		report << "\t\t{\"minimizer\": " << bucket.first << ", \"reference_words\": " << bucket.second.first
+			   << ", \"query_words\": " << bucket.second.second << "}" << (++i < bucketWords.size() ? ",\n" : "\n");
+	}
+	report << "\t],\n";
+
+	report << "\t\"info\": {\n";
+	i = 0;
+	for (auto const &info : infos) {
+		report << "\t\t\"" << PlacementWriter::json_escape(info.first) << "\": \"" << PlacementWriter::json_escape(info.second) << "\"" << (++i < infos.size() ? ",\n" : "\n");
+	}
+	report << "\t}\n";
+	report << "}\n";
+}
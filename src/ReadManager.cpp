@@ -15,45 +15,133 @@
  */
 
 #include <math.h>
+#include <algorithm>
+#include <unordered_map>
 #include "ReadManager.h"
 #include "SeqIO.h"
+#include "Profiler.h"
 
-ReadManager::ReadManager(std::string readsfname) {
-	if (fswm_params::g_verbose) { std::cout << "-> Reading reads from file: " << readsfname << std::endl; }
+ReadManager::ReadManager(std::string readsfname, SequenceRegistry &registry, const Parameters &params)
+	: params(params), readBlockSize(params.readBlockSize) {
+	if (params.verbose) { std::cout << "-> Reading reads from file: " << readsfname << std::endl; }
 
-	SeqIO::read_sequences(readsfname, reads, false);
-	if (fswm_params::g_verbose) { std::cout << "\t" << reads.size() << " reads found and read."<< std::endl; }
+	{
+		ProfilerTimer timer(Profiler::QUERY_PARSING);
+		SeqIO::read_sequences(readsfname, reads, false, registry, params);
+	}
+	if (params.verbose) { std::cout << "\t" << reads.size() << " reads found and read."<< std::endl; }
+	if (params.dereplicate) {
+		dereplicate(registry);
+	}
+
+	partitions = ceil((double) reads.size() / readBlockSize);
+	if (params.verbose) { std::cout << "\tDividing into " << partitions << " partitions" << std::endl; }
+
+	this->readCount = reads.size();
+}
 
-	partitions = ceil((double) reads.size() / fswm_params::g_readBlockSize);
-	if (fswm_params::g_verbose) { std::cout << "\tDividing into " << partitions << " partitions" << std::endl; }
+ReadManager::ReadManager(const std::vector<std::pair<std::string, std::string>> &queries, SequenceRegistry &registry,
+		const Parameters &params) : params(params), readBlockSize(params.readBlockSize) {
+	for (auto const &query : queries) {
+		std::string header = query.first.substr(0, query.first.find(' '));
+		std::string seqLine = query.second;
+		reads.push_back(Sequence(header, seqLine, registry.new_seqID()));
+	}
+	if (params.dereplicate) {
+		dereplicate(registry);
+	}
 
+	partitions = ceil((double) reads.size() / readBlockSize);
 	this->readCount = reads.size();
-	this->currentSeq = 0;
-	this->currentPartition = 0;
 }
 
 /**
- * Return BucketManager for the next partition of reads from input read sequences.
+ * Keep the first query of every sequence as read. Reads were given the last
+ * sequence IDs, so the remaining reads are numbered consecutively again and
+ * the IDs of removed duplicates are given back.
+ */
+void ReadManager::dereplicate(SequenceRegistry &registry) {
+	if (reads.empty()) {
+		return;
+	}
+	seq_id_t firstID = reads.front().get_seqID();
+	std::unordered_map<std::string, uint32_t> sequenceReads;
+	std::vector<Sequence> uniqueReads;
+
+	queryReads.reserve(reads.size());
+	for (auto &read : reads) {
+		const std::vector<char> &sequence = read.get_sequence();
+		auto inserted = sequenceReads.insert(std::make_pair(std::string(sequence.begin(), sequence.end()), (uint32_t) uniqueReads.size()));
+		if (inserted.second) {
+			read.set_seqID(firstID + uniqueReads.size());
+			uniqueReads.push_back(std::move(read));
+			duplicateNames.push_back(std::vector<std::string>());
+		}
+		else {
+			duplicateNames[inserted.first->second].push_back(read.get_header());
+		}
+		queryReads.push_back(inserted.first->second);
+	}
+
+	std::cout << "\t" << reads.size() << " queries with " << uniqueReads.size() << " unique sequences." << std::endl;
+	Profiler::set_info("queries", std::to_string(reads.size()));
+	Profiler::set_info("unique_queries", std::to_string(uniqueReads.size()));
+	reads.swap(uniqueReads);
+	registry.set_lastSeqID(firstID + reads.size() - 1);
+}
+
+/**
+ * Fill BucketManager with the reads of a partition of the input read sequences.
+ * Reads are only read, so partitions can be created by several threads at once.
  */
-std::vector<seq_id_t> ReadManager::get_next_partition_BucketManager(std::vector<Seed> &seeds, BucketManager &bucketManagerReads) {
-	if (fswm_params::g_verbose) { std::cout << "\t-> Creating spaced words for read partition " << currentPartition << std::endl; }
+std::vector<seq_id_t> ReadManager::get_partition_BucketManager(uint32_t partition, std::vector<Seed> &seeds,
+		BucketManager &bucketManagerReads, std::vector<std::string> &readNames,
+		std::vector<std::vector<std::string>> *duplicateNames) {
+	if (params.verbose) { std::cout << "\t-> Creating spaced words for read partition " << partition << std::endl; }
 
 	std::vector<seq_id_t> readIDs;
+	size_t first = (size_t) partition * readBlockSize;
+	size_t last = std::min(first + readBlockSize, reads.size());
 
-	for (int i = 0; i < fswm_params::g_readBlockSize and currentSeq < reads.size(); i++) {
-		reads[currentSeq].fill_buckets(seeds, bucketManagerReads);
-		fswm_internal::readIDsToNames[reads[currentSeq].get_seqID()] = reads[currentSeq].get_header();
-		fswm_internal::namesToReadIDs[reads[currentSeq].get_header()] = reads[currentSeq].get_seqID();		
-		readIDs.push_back(reads[currentSeq].get_seqID());
-		currentSeq++;
+	{
+		ProfilerTimer timer(Profiler::FILL_BUCKETS);
+		for (size_t currentSeq = first; currentSeq < last; currentSeq++) {
+			reads[currentSeq].fill_buckets(seeds, bucketManagerReads, params);
+			readNames.push_back(reads[currentSeq].get_header());
+			readIDs.push_back(reads[currentSeq].get_seqID());
+			if (duplicateNames != nullptr and !this->duplicateNames.empty()) {
+				duplicateNames->push_back(this->duplicateNames[currentSeq]);
+			}
+		}
 	}
 
-	bucketManagerReads.create_wordGroups();
+	{
+		ProfilerTimer timer(Profiler::BUCKET_SORT_GROUP);
+		bucketManagerReads.create_wordGroups();
+	}
 
-	currentPartition++;
 	return readIDs;
 }
 
+/**
+ * Spaced words are created for both strands of every read.
+ */
+uint64_t ReadManager::get_wordCount(int numPatterns, int patternLength) const {
+	uint64_t wordCount = 0;
+	for (auto const &read : reads) {
+		if ((int) read.get_length() >= patternLength) {
+			wordCount += 2 * (read.get_length() - patternLength + 1);
+		}
+	}
+	return wordCount * numPatterns;
+}
+
+void ReadManager::set_readBlockSize(uint32_t readBlockSize) {
+	this->readBlockSize = readBlockSize;
+	partitions = ceil((double) reads.size() / readBlockSize);
+	if (params.verbose) { std::cout << "\tDividing into " << partitions << " partitions" << std::endl; }
+}
+
 uint32_t ReadManager::get_partitions() const {
 	return partitions;
 }
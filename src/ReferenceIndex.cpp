@@ -0,0 +1,594 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ReferenceIndex.h"
+#include "Sequence.h"
+#include "SeqIO.h"
+#include "Seed.h"
+#include "Tree.h"
+#include "Placement.h"
+#include "GlobalParameters.h"
+
+static const uint32_t minimizerCount = 16;
+
+// Words are stored packed as matches, don't cares, sequence ID and position
+static const uint32_t wordBytes = sizeof(word_t) * 2 + sizeof(seq_id_t) + sizeof(pos_t);
+static const size_t wordsPerBlock = 1 << 16;
+
+static void write_raw(std::ofstream &out, const void *data, size_t size) {
+	out.write(reinterpret_cast<const char*>(data), size);
+}
+
+static void write_string(std::ofstream &out, const std::string &str) {
+	uint32_t size = str.size();
+	write_raw(out, &size, sizeof(size));
+	out.write(str.data(), size);
+}
+
+static bool read_raw(std::ifstream &in, void *data, size_t size) {
+	in.read(reinterpret_cast<char*>(data), size);
+	return in.good();
+}
+
+static bool read_string(std::ifstream &in, std::string &str) {
+	uint32_t size;
+	if (!read_raw(in, &size, sizeof(size))) {
+		return false;
+	}
+	str.resize(size);
+	return size == 0 or read_raw(in, &str[0], size);
+}
+
+ReferenceIndex::ReferenceIndex() {
+	this->weight = 0;
+	this->spaces = 0;
+	this->sampling = false;
+	this->hashLimit = 0;
+	this->draftGenomes = false;
+	this->delimiter = "";
+	this->nextID = 0;
+	this->buckets.resize(minimizerCount);
+}
+
+ReferenceIndex::ReferenceIndex(const std::vector<std::string> &patterns, const Parameters &params) {
+	this->weight = params.weight;
+	this->spaces = params.spaces;
+	this->sampling = params.sampling;
+	this->hashLimit = params.minHashLowerLimit;
+	this->draftGenomes = params.draftGenomes;
+	this->delimiter = params.delimiter;
+	this->nextID = 0;
+	this->patterns = patterns;
+	this->buckets.resize(minimizerCount);
+}
+
+std::string ReferenceIndex::get_index_filename(std::string foldername) {
+	return foldername + "/references.idx";
+}
+
+std::string ReferenceIndex::get_tree_filename(std::string foldername) {
+	return foldername + "/tree.nwk";
+}
+
+/**
+ * Binary format (native byte order):
+ * 	header:   "APPSPAMI", uint32 version, uint32 bytes per word, uint16 weight, uint16 don't cares,
+ * 	          uint8 sampling, uint8 unassembled, int32 hash limit, uint32 next index ID, string delimiter
+ * 	patterns: uint32 count, strings
+ * 	names:    uint32 count, for every reference uint32 index ID and string name
+ * 	buckets:  uint32 count, for every bucket uint64 number of words and the words in Bucket::word_order,
+ * 	          each as uint64 matches, uint64 don't cares, uint32 sequence ID and uint32 position
+ * Strings are stored as uint32 length and bytes.
+ */
+bool ReferenceIndex::save(std::string foldername) const {
+	mkdir(foldername.c_str(), 0755);
+	std::string filename = get_index_filename(foldername);
+	std::string tmpfname = filename + "." + std::to_string(getpid()) + ".tmp";
+	std::ofstream out(tmpfname, std::ios::binary);
+	if (!out.is_open()) {
+		return false;
+	}
+
+	uint32_t version = binaryVersion;
+	uint32_t wordSize = wordBytes;
+	uint8_t samplingFlag = sampling;
+	uint8_t draftFlag = draftGenomes;
+	out.write("APPSPAMI", 8);
+	write_raw(out, &version, sizeof(version));
+	write_raw(out, &wordSize, sizeof(wordSize));
+	write_raw(out, &weight, sizeof(weight));
+	write_raw(out, &spaces, sizeof(spaces));
+	write_raw(out, &samplingFlag, sizeof(samplingFlag));
+	write_raw(out, &draftFlag, sizeof(draftFlag));
+	write_raw(out, &hashLimit, sizeof(hashLimit));
+	write_raw(out, &nextID, sizeof(nextID));
+	write_string(out, delimiter);
+
+	uint32_t count = patterns.size();
+	write_raw(out, &count, sizeof(count));
+	for (auto const &pattern : patterns) {
+		write_string(out, pattern);
+	}
+
+	count = genomeIDsToNames.size();
+	write_raw(out, &count, sizeof(count));
+	for (auto const &genome : genomeIDsToNames) {
+		uint32_t id = genome.first;
+		write_raw(out, &id, sizeof(id));
+		write_string(out, genome.second);
+	}
+
+	count = buckets.size();
+	write_raw(out, &count, sizeof(count));
+	for (auto const &words : buckets) {
+		uint64_t wordCount = words.size();
+		write_raw(out, &wordCount, sizeof(wordCount));
+		std::string block;
+		for (size_t i = 0; i < words.size(); i++) {
+			block.append(reinterpret_cast<const char*>(&words[i].matches), sizeof(word_t));
+			block.append(reinterpret_cast<const char*>(&words[i].dontCares), sizeof(word_t));
+			block.append(reinterpret_cast<const char*>(&words[i].seqID), sizeof(seq_id_t));
+			block.append(reinterpret_cast<const char*>(&words[i].seqPos), sizeof(pos_t));
+			if ((i + 1) % wordsPerBlock == 0 or i + 1 == words.size()) {
+				out.write(block.data(), block.size());
+				block.clear();
+			}
+		}
+	}
+
+	out.close();
+	if (!out.good() or rename(tmpfname.c_str(), filename.c_str()) != 0) {
+		unlink(tmpfname.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool ReferenceIndex::load(std::string foldername) {
+	std::ifstream in(get_index_filename(foldername), std::ios::binary);
+	if (!in.is_open()) {
+		return false;
+	}
+
+	char magic[8];
+	uint32_t version, wordSize;
+	uint8_t samplingFlag, draftFlag;
+	if (!read_raw(in, magic, 8) or std::string(magic, 8) != "APPSPAMI" or !read_raw(in, &version, sizeof(version))
+			or version != binaryVersion or !read_raw(in, &wordSize, sizeof(wordSize)) or wordSize != wordBytes) {
+		return false;
+	}
+	if (!read_raw(in, &weight, sizeof(weight)) or !read_raw(in, &spaces, sizeof(spaces))
+			or !read_raw(in, &samplingFlag, sizeof(samplingFlag)) or !read_raw(in, &draftFlag, sizeof(draftFlag))
+			or !read_raw(in, &hashLimit, sizeof(hashLimit)) or !read_raw(in, &nextID, sizeof(nextID))
+			or !read_string(in, delimiter)) {
+		return false;
+	}
+	sampling = samplingFlag;
+	draftGenomes = draftFlag;
+
+	uint32_t count;
+	if (!read_raw(in, &count, sizeof(count))) {
+		return false;
+	}
+	patterns.assign(count, "");
+	for (auto &pattern : patterns) {
+		if (!read_string(in, pattern)) {
+			return false;
+		}
+	}
+
+	if (!read_raw(in, &count, sizeof(count))) {
+		return false;
+	}
+	genomeIDsToNames.clear();
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t id;
+		std::string name;
+		if (!read_raw(in, &id, sizeof(id)) or !read_string(in, name)) {
+			return false;
+		}
+		genomeIDsToNames[id] = name;
+	}
+
+	if (!read_raw(in, &count, sizeof(count)) or count != minimizerCount) {
+		return false;
+	}
+	buckets.assign(count, std::vector<Word>());
+	for (auto &words : buckets) {
+		uint64_t wordCount;
+		if (!read_raw(in, &wordCount, sizeof(wordCount))) {
+			return false;
+		}
+		words.clear();
+		words.reserve(wordCount);
+		std::vector<char> block(wordsPerBlock * wordBytes);
+		for (uint64_t start = 0; start < wordCount; start += wordsPerBlock) {
+			size_t blockWords = std::min<uint64_t>(wordsPerBlock, wordCount - start);
+			if (!read_raw(in, block.data(), blockWords * wordBytes)) {
+				return false;
+			}
+			for (const char *word = block.data(); word < block.data() + blockWords * wordBytes; word += wordBytes) {
+				word_t matches, dontCares;
+				seq_id_t seqID;
+				pos_t seqPos;
+				memcpy(&matches, word, sizeof(word_t));
+				memcpy(&dontCares, word + sizeof(word_t), sizeof(word_t));
+				memcpy(&seqID, word + 2 * sizeof(word_t), sizeof(seq_id_t));
+				memcpy(&seqPos, word + 2 * sizeof(word_t) + sizeof(seq_id_t), sizeof(pos_t));
+				words.push_back(Word(seqID, seqPos, matches, dontCares));
+			}
+		}
+	}
+	return true;
+}
+
+void ReferenceIndex::apply_parameters(Parameters &params) const {
+	params.weight = weight;
+	params.spaces = spaces;
+	params.numPatterns = patterns.size();
+	params.sampling = sampling;
+	params.minHashLowerLimit = hashLimit;
+	params.draftGenomes = draftGenomes;
+	params.delimiter = delimiter;
+	GlobalParameters::calculate_filteringThreshold(params);
+}
+
+/**
+ * Words of the new references are sorted and merged into the sorted words of each bucket,
+ * the words of references already in the index are not touched.
+ */
+uint32_t ReferenceIndex::add_references(std::string fastafname, const Parameters &params) {
+	std::vector<Seed> seeds;
+	for (auto pattern : patterns) {
+		Seed seed(weight, spaces);
+		seed.generate_pattern(pattern, params.verbose);
+		seeds.push_back(seed);
+	}
+
+	std::unordered_set<std::string> names;
+	for (auto const &genome : genomeIDsToNames) {
+		names.insert(genome.second);
+	}
+
+	// New references get the index IDs after nextID
+	std::vector<Sequence> genomes;
+	SequenceRegistry registry;
+	registry.set_lastSeqID(nextID - 1);
+	SeqIO::read_sequences(fastafname, genomes, true, registry, params);
+	for (auto const &genome : genomes) {
+		if (names.find(genome.get_header()) != names.end()) {
+			std::cerr << "ERROR: Reference " << genome.get_header() << " is already in the index. Remove it first to replace it." << std::endl;
+			exit (EXIT_FAILURE);
+		}
+	}
+
+	BucketManager bucketManager;
+	for (auto &genome : genomes) {
+		genome.fill_buckets(seeds, bucketManager, params);
+		genomeIDsToNames[genome.get_seqID()] = genome.get_header();
+	}
+	genomes.clear();
+
+	for (minimizer_t minimizer = 0; minimizer < minimizerCount; minimizer++) {
+		std::vector<Word> &newWords = bucketManager.get_words(minimizer);
+		std::sort(newWords.begin(), newWords.end(), Bucket::word_order);
+		size_t middle = buckets[minimizer].size();
+		buckets[minimizer].insert(buckets[minimizer].end(), newWords.begin(), newWords.end());
+		std::inplace_merge(buckets[minimizer].begin(), buckets[minimizer].begin() + middle, buckets[minimizer].end(), Bucket::word_order);
+		std::vector<Word>().swap(newWords);
+	}
+
+	uint32_t added = registry.get_lastSeqID() + 1 - nextID;
+	nextID = registry.get_lastSeqID() + 1;
+	return added;
+}
+
+uint32_t ReferenceIndex::remove_references(const std::unordered_set<std::string> &names) {
+	std::unordered_set<seq_id_t> removedIDs;
+	for (auto it = genomeIDsToNames.begin(); it != genomeIDsToNames.end(); ) {
+		if (names.find(it->second) != names.end()) {
+			removedIDs.insert(it->first);
+			it = genomeIDsToNames.erase(it);
+		}
+		else {
+			it++;
+		}
+	}
+	if (removedIDs.empty()) {
+		return 0;
+	}
+
+	// Removing keeps the words sorted
+	for (auto &words : buckets) {
+		words.erase(std::remove_if(words.begin(), words.end(),
+				[&removedIDs](const Word &word) { return removedIDs.find(word.seqID) != removedIDs.end(); }), words.end());
+	}
+	return removedIDs.size();
+}
+
+void ReferenceIndex::move_to_BucketManager(BucketManager &bucketManager, SequenceRegistry &registry) {
+	std::vector<seq_id_t> indexIDsToSeqIDs(nextID, 0);
+	for (auto const &genome : genomeIDsToNames) {
+		seq_id_t seqID = registry.new_seqID();
+		if (registry.has_sequence(genome.second)) {
+			std::cerr << "Multiple sequences in the genomes seem to have the same name. Please fix: " << genome.second << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		registry.register_genome(seqID, genome.second);
+		indexIDsToSeqIDs[genome.first] = seqID;
+	}
+
+	for (minimizer_t minimizer = 0; minimizer < minimizerCount; minimizer++) {
+		for (auto &word : buckets[minimizer]) {
+			word.seqID = indexIDsToSeqIDs[word.seqID];
+		}
+		bucketManager.set_words(minimizer, buckets[minimizer]);
+		std::vector<Word>().swap(buckets[minimizer]);
+	}
+	genomeIDsToNames.clear();
+}
+
+uint64_t ReferenceIndex::get_wordCount() const {
+	uint64_t count = 0;
+	for (auto const &words : buckets) {
+		count += words.size();
+	}
+	return count;
+}
+
+static void print_index_help() {
+	std::cout << R""""(
+Create or update a reference index with:
+	./appspam index -i <index> --add <references> --tree <tree> [parameters]
+	./appspam index -i <index> --remove <names> [--tree <tree>]
+Place queries with the index:
+	./appspam -i <index> -q <queries> [optional parameters]
+
+    -i  --index             Folder of the index (default appspam_index).
+    -a  --add               Fasta file with references to add. Creates the
+                            index if it does not exist yet.
+    -r  --remove            Comma separated names of references to remove,
+                            or a file with one name per line.
+    -t  --tree              Reference tree stored in the index. Its leaves must
+                            be exactly the references of the index. Required
+                            whenever references are added or removed.
+    -l  --list              Print the names of all references in the index.
+
+Parameters used when the index is created (fixed afterwards):
+    -w  --weight            Weight of pattern.
+    -d  --dontCare          Number of don't care positions.
+    -p  --pattern           Number of patterns.
+        --pattern-file      File with patterns to use.
+        --pattern-seed      Seed of the pattern optimization.
+        --sampling          Experimental: Samples the spaced word matches.
+        --hashlimit         Hash limit used for sampling.
+    -u  --unassembled       Use unassembled references.
+        --delimiter         Delimiter used for unassembled references.
+)"""";
+}
+
+/** Names separated by commas or, if names is an existing file, one name per line. */
+static std::unordered_set<std::string> parse_names(std::string names) {
+	std::ifstream namesFile(names);
+	std::unordered_set<std::string> parsed;
+	std::string name;
+	if (namesFile.good()) {
+		while (std::getline(namesFile, name)) {
+			name = name.substr(0, name.find_last_not_of(" \t\r") + 1);
+			if (!name.empty()) {
+				parsed.insert(name);
+			}
+		}
+	}
+	else {
+		std::stringstream namesStream(names);
+		while (std::getline(namesStream, name, ',')) {
+			if (!name.empty()) {
+				parsed.insert(name);
+			}
+		}
+	}
+	return parsed;
+}
+
+int ReferenceIndex::index_command(int argc, char *argv[]) {
+	std::string indexfoldername = "appspam_index";
+	std::string addfname = "";
+	std::string removeNames = "";
+	std::string treefname = "";
+	bool list = false;
+
+	static struct option long_options[] = {
+		{ "index", required_argument, 			nullptr, 'i' },
+		{ "add", required_argument, 			nullptr, 'a' },
+		{ "remove", required_argument, 			nullptr, 'r' },
+		{ "tree", required_argument, 			nullptr, 't' },
+		{ "list", no_argument, 					nullptr, 'l' },
+		{ "weight", required_argument, 			nullptr, 'w' },
+		{ "dontCare", required_argument, 		nullptr, 'd' },
+		{ "pattern", required_argument, 		nullptr, 'p' },
+		{ "unassembled", no_argument, 			nullptr, 'u' },
+		{ "verbose", no_argument, 				nullptr, 'v' },
+		{ "help", no_argument, 					nullptr, 'h' },
+		{ "sampling", no_argument, 				nullptr, 4   },
+		{ "delimiter", required_argument, 		nullptr, 6   },
+		{ "hashlimit", required_argument, 		nullptr, 9   },
+		{ "pattern-seed", required_argument, 	nullptr, 16  },
+		{ "pattern-cache", required_argument, 	nullptr, 17  },
+		{ "pattern-file", required_argument, 	nullptr, 18  },
+		0
+	};
+
+	int option_param, index;
+	while ((option_param = getopt_long(argc, argv, "i:a:r:t:lw:d:p:uvh", long_options, &index)) != -1) {
+		switch (option_param) {
+			case 'i': indexfoldername = optarg; break;
+			case 'a': addfname = optarg; break;
+			case 'r': removeNames = optarg; break;
+			case 't': treefname = optarg; break;
+			case 'l': list = true; break;
+			case 'w': fswm_params::g_weight = atoi(optarg); break;
+			case 'd': fswm_params::g_spaces = atoi(optarg); break;
+			case 'p': fswm_params::g_numPatterns = atoi(optarg); break;
+			case 'u': fswm_params::g_draftGenomes = true; break;
+			case 'v': fswm_params::g_verbose = true; break;
+			case 4: fswm_params::g_sampling = true; break;
+			case 6: fswm_params::g_delimiter = optarg; break;
+			case 9: fswm_params::g_minHashLowerLimit = atoi(optarg); break;
+			case 16: {
+				uint64_t seed = 0;
+				if (!GlobalParameters::parse_number(optarg, UINT32_MAX, seed)) {
+					std::cerr << "ERROR: Pattern seed must be a number between 0 and " << UINT32_MAX << "." << std::endl;
+					return EXIT_FAILURE;
+				}
+				fswm_params::g_patternSeed = seed;
+				break;
+			}
+			case 17: fswm_params::g_patternCache = std::string(optarg) == "none" ? "" : optarg; break;
+			case 18: fswm_params::g_patternfname = optarg; break;
+			default:
+				print_index_help();
+				return EXIT_SUCCESS;
+		}
+	}
+	if (addfname.empty() and removeNames.empty() and treefname.empty() and !list) {
+		print_index_help();
+		return EXIT_SUCCESS;
+	}
+
+	Parameters params = GlobalParameters::get_parameters();
+	ReferenceIndex referenceIndex;
+	bool exists = std::ifstream(get_index_filename(indexfoldername)).good();
+	if (exists and !referenceIndex.load(indexfoldername)) {
+		std::cerr << "ERROR: " << get_index_filename(indexfoldername) << " is not a valid index of this version of appspam." << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (!exists) {
+		if (addfname.empty()) {
+			std::cerr << "ERROR: No index found in " << indexfoldername << ". Create it with --add." << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (params.patternfname.empty() and (params.weight < 2 or params.weight > 32
+				or params.spaces < 2 or params.spaces > 32 or params.numPatterns < 1)) {
+			std::cerr << "ERROR: Weight and don't care positions must be between 2 and 32 and at least one pattern is needed." << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::vector<std::string> patterns = Placement::create_patterns(params);
+		referenceIndex = ReferenceIndex(patterns, params);
+		std::cout << "-> Creating index in " << indexfoldername << std::endl;
+	}
+	referenceIndex.apply_parameters(params);
+
+	bool changed = !exists;
+	if (!removeNames.empty()) {
+		std::unordered_set<std::string> names = parse_names(removeNames);
+		uint32_t removed = referenceIndex.remove_references(names);
+		if (removed != names.size()) {
+			std::cerr << "WARNING: " << names.size() - removed << " of the references to remove are not in the index." << std::endl;
+		}
+		std::cout << "-> Removed " << removed << " references." << std::endl;
+		changed = changed or removed > 0;
+	}
+	if (!addfname.empty()) {
+		if (!std::ifstream(addfname).good()) {
+			std::cerr << "ERROR: Please supply an existing file for the references." << std::endl;
+			return EXIT_FAILURE;
+		}
+		uint32_t added = referenceIndex.add_references(addfname, params);
+		std::cout << "-> Added " << added << " references." << std::endl;
+		changed = true;
+	}
+
+	// Leaves of the tree used for placement must be exactly the references of the index
+	if (treefname.empty() and changed) {
+		std::cerr << "ERROR: Supply the reference tree of the updated references with --tree." << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (!treefname.empty()) {
+		if (!std::ifstream(treefname).good()) {
+			std::cerr << "ERROR: Please supply an existing file for the reference tree." << std::endl;
+			return EXIT_FAILURE;
+		}
+		// Nodes of the tree get IDs after the index IDs of the references
+		SequenceRegistry registry;
+		for (auto const &genome : referenceIndex.get_genomes()) {
+			registry.register_genome(genome.first, genome.second);
+			registry.set_lastSeqID(genome.first);
+		}
+		Tree tree(treefname, registry, params);		// Exits if a leaf is not a reference
+		std::unordered_set<std::string> leaves;
+		for (auto const &leaf : tree.leave_iterator) {
+			leaves.insert(leaf->name);
+		}
+		for (auto const &genome : referenceIndex.get_genomes()) {
+			if (leaves.find(genome.second) == leaves.end()) {
+				std::cerr << "ERROR: Reference " << genome.second << " is not a leaf of the tree " << treefname << "." << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	// Both files are written to temporary names first and only renamed once both writes succeeded
+	// (index first), so a failed update does not leave a new tree next to the old index
+	std::string treeTmpfname = "";
+	if (!treefname.empty()) {
+		std::ifstream treeIn(treefname);
+		std::stringstream treeStr;
+		treeStr << treeIn.rdbuf();
+		mkdir(indexfoldername.c_str(), 0755);
+		treeTmpfname = get_tree_filename(indexfoldername) + "." + std::to_string(getpid()) + ".tmp";
+		std::ofstream treeOut(treeTmpfname);
+		treeOut << treeStr.str();
+		treeOut.close();
+		if (!treeOut.good()) {
+			unlink(treeTmpfname.c_str());
+			std::cerr << "ERROR: Could not write tree to " << indexfoldername << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (changed and !referenceIndex.save(indexfoldername)) {
+		if (!treeTmpfname.empty()) {
+			unlink(treeTmpfname.c_str());
+		}
+		std::cerr << "ERROR: Could not write index to " << indexfoldername << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (!treeTmpfname.empty() and rename(treeTmpfname.c_str(), get_tree_filename(indexfoldername).c_str()) != 0) {
+		unlink(treeTmpfname.c_str());
+		std::cerr << "ERROR: Could not write tree to " << indexfoldername << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (list) {
+		for (auto const &genome : referenceIndex.get_genomes()) {
+			std::cout << genome.second << std::endl;
+		}
+	}
+	std::cout << "-> Index " << indexfoldername << ": " << referenceIndex.get_genomes().size() << " references, "
+			  << referenceIndex.get_wordCount() << " spaced words." << std::endl;
+	return EXIT_SUCCESS;
+}
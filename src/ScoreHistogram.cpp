@@ -0,0 +1,83 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include "ScoreHistogram.h"
+#include "SubstitutionMatrix.h"
+
+/**
+ * Create one bin for every score a spaced word match can reach with the number of don't care positions.
+ */
+ScoreHistogram::ScoreHistogram(const Parameters &params) {
+	SubstitutionMatrix substMat;
+	int minEntry = substMat.chiaromonte[0][0];
+	int maxEntry = substMat.chiaromonte[0][0];
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			minEntry = std::min(minEntry, substMat.chiaromonte[i][j]);
+			maxEntry = std::max(maxEntry, substMat.chiaromonte[i][j]);
+		}
+	}
+
+	this->perPair = params.histogramPerPair;
+	this->minScore = minEntry * params.spaces;
+	this->counts.assign((maxEntry - minEntry) * params.spaces + 1, 0);
+}
+
+void ScoreHistogram::merge(const ScoreHistogram &other) {
+	for (size_t i = 0; i < counts.size(); i++) {
+		counts[i] += other.counts[i];
+	}
+	for (auto const &pair : other.pairCounts) {
+		std::unordered_map<int, uint64_t> &bins = pairCounts[pair.first];
+		for (auto const &bin : pair.second) {
+			bins[bin.first] += bin.second;
+		}
+	}
+}
+
+void ScoreHistogram::write_to_file(std::string filename) const {
+	std::ofstream histogramFile(filename);
+
+	if (!perPair) {
+		histogramFile << "score\tcount\n";
+		for (size_t i = 0; i < counts.size(); i++) {
+			if (counts[i] > 0) {
+				histogramFile << (int) i + minScore << "\t" << counts[i] << "\n";
+			}
+		}
+		return;
+	}
+
+	// Sort pairs and scores for reproducible output
+	std::vector<uint64_t> keys;
+	keys.reserve(pairCounts.size());
+	for (auto const &pair : pairCounts) {
+		keys.push_back(pair.first);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	histogramFile << "read\treference\tscore\tcount\n";
+	for (auto const key : keys) {
+		std::vector<std::pair<int, uint64_t>> bins(pairCounts.at(key).begin(), pairCounts.at(key).end());
+		std::sort(bins.begin(), bins.end());
+		for (auto const &bin : bins) {
+			histogramFile << (seq_id_t) (key >> 32) << "\t" << (seq_id_t) key << "\t" << bin.first << "\t" << bin.second << "\n";
+		}
+	}
+}
@@ -19,17 +19,46 @@
 #include <iostream>
 #include <fstream>
 #include <math.h>
+#include <algorithm>
+#include <functional>
 #include "Scoring.h"
 #include "Tree.h"
+#include "SequenceRegistry.h"
 #include <vector>
 
 
 Scoring::Scoring() {
+	this->firstReadID = 0;
+}
 
+/**
+ * Scores are sums of integers, so they do not depend on the order of addition.
+ * Pairs are inserted in the order of their first match, which keeps the
+ * iteration order of the maps (and thus ties) as in the sequential join.
+ */
+void Scoring::add_partial(const PartialScoring &partialScoring) {
+	for (size_t i = 0; i < partialScoring.pairs.size(); i++) {
+		seq_id_t readID = partialScoring.pairs[i].first;
+		seq_id_t genomeID = partialScoring.pairs[i].second;
+		if (!removedReferences.empty()) {
+			auto removed = removedReferences.find(readID);
+			if (removed != removedReferences.end() and removed->second.count(genomeID) > 0) {
+				continue;
+			}
+		}
+		if (scoringMap.find(readID) == scoringMap.end()) {
+			scoringMap[readID] = std::unordered_map<seq_id_t, scoring_t>();
+			mismatchCount[readID] = std::unordered_map<seq_id_t, count_t>();
+			spacedWordMatchCount[readID] = std::unordered_map<seq_id_t, count_t>();
+		}
+		scoringMap[readID][genomeID] += partialScoring.scores[i];
+		mismatchCount[readID][genomeID] += partialScoring.mismatches[i];
+		spacedWordMatchCount[readID][genomeID] += partialScoring.matches[i];
+	}
 }
 
 /** Calculate jk-corrected distances between fswm based on mismatch counts. */
-void Scoring::calculate_fswm_distances() {
+void Scoring::calculate_fswm_distances(const Parameters &params) {
 	double substFreq = 0;	// Calculated plain substitution frequency
 	double jk = 0;			// Jukes-Cantor corrected substitution frequency
 
@@ -45,10 +74,10 @@ void Scoring::calculate_fswm_distances() {
 
 		while (it11 != it1->second.end()) {		// Iterate through genomes
 			if (it31->second <= 0) { 			// Reads with not matches get default distance
-				it11->second = fswm_params::g_defaultDistance;
+				it11->second = params.defaultDistance;
 			}
 			else {
-				substFreq = (double) it21->second / (it31->second * fswm_params::g_spaces);
+				substFreq = (double) it21->second / (it31->second * params.spaces);
 				jk = -0.75 * log(1.0 - ((4.0/3.0) * substFreq));
 
 				it11->second = jk;
@@ -63,9 +92,49 @@ void Scoring::calculate_fswm_distances() {
 	}
 }
 
+/**
+ * Keep only the k references with most spaced word matches for every read that has more than
+ * limit references. References tied with the k-th best count are kept as well, so that the
+ * placement modes choose among the same best references as without the reduction. Removed
+ * references are remembered and not counted again by later buckets.
+ */
+void Scoring::retain_top_references(uint32_t k, uint32_t limit) {
+	if (k == 0) {
+		return;
+	}
+
+	std::vector<count_t> counts;
+	for (auto &read : spacedWordMatchCount) {
+		if (read.second.size() <= limit) {
+			continue;
+		}
+
+		counts.clear();
+		for (auto const &genome : read.second) {
+			counts.push_back(genome.second);
+		}
+		std::nth_element(counts.begin(), counts.begin() + (k - 1), counts.end(), std::greater<count_t>());
+		count_t minCount = counts[k - 1];
+
+		seqIDtoScoring_t &readScoring = scoringMap[read.first];
+		seqIDtoCount_t &readMismatches = mismatchCount[read.first];
+		std::unordered_set<seq_id_t> &readRemoved = removedReferences[read.first];
+		for (auto genome_it = read.second.begin(); genome_it != read.second.end(); ) {
+			if (genome_it->second < minCount) {
+				readRemoved.insert(genome_it->first);
+				readScoring.erase(genome_it->first);
+				readMismatches.erase(genome_it->first);
+				genome_it = read.second.erase(genome_it);
+			}
+			else {
+				genome_it++;
+			}
+		}
+	}
+}
+
 /** Assign reads to reference tree of genome. */
-void Scoring::phylogenetic_placement(std::vector<seq_id_t> readIDs) {
-	Tree tree(fswm_params::g_reftreefname);				// Read and create reference tree
+void Scoring::phylogenetic_placement(std::vector<seq_id_t> readIDs, Tree &tree, const Parameters &params) {
 	int min_j;											// Currently minimum assigned genome. -1 for unassigned.
 	countMap_t::iterator countMap_it = spacedWordMatchCount.begin();
 
@@ -74,29 +143,57 @@ void Scoring::phylogenetic_placement(std::vector<seq_id_t> readIDs) {
 		readAssignmentTracker[readID] = false;             // Later on: assign reads that have not been assigned by algorithm to root of tree
 	}
 
-   	for (scoringMap_t::iterator scoringMap_it = scoringMap.begin(); scoringMap_it != scoringMap.end(); scoringMap_it++) {		// Iterate through reads
-		min_j = -1;
-
-		if (fswm_params::g_assignmentMode == "SPAMCOUNT") {
-			min_j = tree.get_node_best_count(countMap_it);
-		}
-		else if (fswm_params::g_assignmentMode == "MINDIST") {
-			min_j = tree.get_node_best_score(scoringMap_it);
+	if (params.assignmentMode == "APPLES") {
+		// Least-squares placement is independent for every read, so reads are placed as tasks
+		// that idle threads of the enclosing parallel region can pick up.
+		std::vector<scoringMap_t::iterator> scoringMap_its;
+		for (scoringMap_t::iterator scoringMap_it = scoringMap.begin(); scoringMap_it != scoringMap.end(); scoringMap_it++) {
+			scoringMap_its.push_back(scoringMap_it);
 		}
-		else if (fswm_params::g_assignmentMode == "LCACOUNT") {
-			min_j = tree.get_LCA_best_count(countMap_it);
-		}
-		else if (fswm_params::g_assignmentMode == "LCADIST") {
-			min_j = tree.get_LCA_best_score(scoringMap_it);
+
+		std::vector<seq_id_t> placementIDs(scoringMap_its.size());
+		std::vector<std::pair<double, double>> placementLengths(scoringMap_its.size());
+
+		#pragma omp taskloop shared(scoringMap_its, placementIDs, placementLengths, tree)
+		for (int64_t i = 0; i < (int64_t) scoringMap_its.size(); i++) {
+			placementIDs[i] = tree.get_least_squares_placement(scoringMap_its[i], placementLengths[i].first, placementLengths[i].second);
 		}
-		else if (fswm_params::g_assignmentMode == "SPAMX") {
-			min_j = tree.get_LCA_best_count_exp(countMap_it, fswm_params::g_spam_X);
+
+		for (size_t i = 0; i < scoringMap_its.size(); i++) {
+			readAssignment.push_back(std::pair<seq_id_t, int> (scoringMap_its[i]->first, placementIDs[i]));
+			readAssignmentTracker[scoringMap_its[i]->first] = true;
+			branchLengths[scoringMap_its[i]->first] = placementLengths[i];
 		}
-		readAssignment.push_back(std::pair<seq_id_t, int> (scoringMap_it->first, min_j));  // assign read to some internal leave, determined based on assignment mode
-		readAssignmentTracker[scoringMap_it->first] = true;
+	}
+	else {
+	   	for (scoringMap_t::iterator scoringMap_it = scoringMap.begin(); scoringMap_it != scoringMap.end(); scoringMap_it++) {		// Iterate through reads
+			min_j = -1;
 
-		countMap_it++;
-   	}
+			if (params.assignmentMode == "SPAMCOUNT") {
+				min_j = tree.get_node_best_count(countMap_it);
+			}
+			else if (params.assignmentMode == "MINDIST") {
+				min_j = tree.get_node_best_score(scoringMap_it);
+			}
+			else if (params.assignmentMode == "LCACOUNT") {
+				min_j = tree.get_LCA_best_count(countMap_it);
+			}
+			else if (params.assignmentMode == "LCADIST") {
+				min_j = tree.get_LCA_best_score(scoringMap_it);
+			}
+			else if (params.assignmentMode == "SPAMX") {
+				min_j = tree.get_LCA_best_count_exp(countMap_it, params.spamX);
+			}
+			readAssignment.push_back(std::pair<seq_id_t, int> (scoringMap_it->first, min_j));  // assign read to some internal leave, determined based on assignment mode
+			readAssignmentTracker[scoringMap_it->first] = true;
+
+			if (params.numPlacements > 1) {
+				weightedPlacements[scoringMap_it->first] = tree.get_weighted_placements(min_j, scoringMap_it, countMap_it, params.numPlacements);
+			}
+
+			countMap_it++;
+	   	}
+	}
 
    	// In the rare case, that no spaced words are found: 
    	// Assign all reads that were not assigned so far to root
@@ -105,24 +202,32 @@ void Scoring::phylogenetic_placement(std::vector<seq_id_t> readIDs) {
    			readAssignment.push_back(std::pair<seq_id_t, int> (read.first, tree.get_rootID()));
    		}
    	}
+}
 
-   	if (fswm_params::g_assignmentMode != "APPLES") {
-   		tree.write_jplace_placement_data(readAssignment, this->scoringMap);
-   	}
-
-   	// tree.write_newick(fswm_params::g_outfoldername + "tree.nwk");
+/** Write placements of all assigned reads to the jplace file. */
+void Scoring::write_placement_to_jplace(Tree &tree, PlacementWriter &writer) {
+	std::vector<std::string> names;
+	for (auto const& read : readAssignment) {
+		names.assign(1, get_readName(read.first));
+		if (!duplicateNames.empty()) {
+			const std::vector<std::string> &duplicates = duplicateNames[read.first - firstReadID];
+			names.insert(names.end(), duplicates.begin(), duplicates.end());
+		}
+		writer.write_placement(read.first, names,
+				tree.get_placement_records(read, this->scoringMap, this->branchLengths, this->weightedPlacements), 1);
+	}
 }
 
 /** Write jk-corrected distances between all reads and genomes to file. */
-void Scoring::write_scoring_to_file() {
+void Scoring::write_scoring_to_file(const Parameters &params) {
 	std::ofstream results;
-	results.open(fswm_params::g_outfoldername + "scoring_list.txt", std::ios_base::app);
+	results.open(params.outfoldername + "scoring_list.txt", std::ios_base::app);
 
 	scoringMap_t::iterator it1 = scoringMap.begin();
 	while (it1 != scoringMap.end()) {
 		seqIDtoScoring_t::iterator it11 = it1->second.begin();
 		while (it11 != it1->second.end()) {
-			results << it1->first << "\t" << it11->first << "\t" << it11->second << std::endl;
+			results << it1->first << "\t" << it11->first << "\t" << it11->second << "\n";
 			it11++;
 		}
 		it1++;
@@ -130,33 +235,25 @@ void Scoring::write_scoring_to_file() {
 	results.close();
 }
 
-/** Write jk-corrected distances between reads and genomes to table. */
-void Scoring::write_scoring_to_file_as_table() {
+/** Write jk-corrected distances between the reads of this partition and all genomes to table. */
+void Scoring::write_scoring_to_file_as_table(const SequenceRegistry &registry, const Parameters &params) {
 	std::ofstream results;
-	results.open(fswm_params::g_outfoldername + "scoring_table.txt", std::ios_base::app);
-
-	std::unordered_map<seq_id_t, std::string> seqIDtoNamesMap;
-	seqIDtoNamesMap = fswm_internal::readIDsToNames;
-
-	for (auto read : seqIDtoNamesMap) {		// For all reads: write distances to all genomes to file
-		results << read.second;
-
-		if (scoringMap.find(read.first) != scoringMap.end()) {					// If read has distances to any genome
-			for (auto genome : fswm_internal::genomeIDsToNames) {	// Write those distances to file and use
-				if (scoringMap[read.first].find(genome.first) != scoringMap[read.first].end()) {
-					results << "\t" << scoringMap[read.first][genome.first];
-				}
-				else {
-					results << "\t" << fswm_params::g_defaultDistance;
-				}
+	results.open(params.outfoldername + "scoring_table.txt", std::ios_base::app);
+
+	for (auto const &assignment : readAssignment) {		// For all reads: write distances to all genomes to file
+		results << get_readName(assignment.first);
+
+		scoringMap_t::iterator read_it = scoringMap.find(assignment.first);
+		for (auto const &genome : registry.get_genomes()) {	// Use default distance for missing pairs
+			seqIDtoScoring_t::iterator genome_it;
+			if (read_it != scoringMap.end() and (genome_it = read_it->second.find(genome.first)) != read_it->second.end()) {
+				results << "\t" << genome_it->second;
 			}
-		}
-		else {
-			for (auto genome : fswm_internal::genomeIDsToNames) {	// Write those distances to file and use
-				results << "\t" << fswm_params::g_defaultDistance;
+			else {
+				results << "\t" << params.defaultDistance;
 			}
 		}
-		results << std::endl;
+		results << "\n";
 	}
 
 	results.close();
@@ -0,0 +1,220 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ScoringWriter.h"
+
+// Rows are filled densely in blocks of at most this many floats before they are written
+static const size_t rowBufferSize = 1 << 22;
+
+static void append_raw(std::string &buffer, const void *data, size_t size) {
+	buffer.append(reinterpret_cast<const char*>(data), size);
+}
+
+static void append_name(std::string &buffer, seq_id_t seqID, const std::string &name) {
+	uint32_t id = seqID;
+	uint32_t size = name.size();
+	append_raw(buffer, &id, sizeof(id));
+	append_raw(buffer, &size, sizeof(size));
+	buffer.append(name);
+}
+
+static bool pwrite_all(int fd, const char *data, size_t size, uint64_t offset) {
+	while (size > 0) {
+		ssize_t written = pwrite(fd, data, size, offset);
+		if (written <= 0) {
+			return false;
+		}
+		data += written;
+		size -= written;
+		offset += written;
+	}
+	return true;
+}
+
+/**
+ * Open binary scoring file, write header and names and reserve space for the whole matrix.
+ * Columns are ordered by genome ID, rows follow the order of the queries in the input file.
+ * Pairs without matches keep defaultDistance.
+ */
+ScoringWriter::ScoringWriter(std::string filename, std::vector<Sequence> &reads, const SequenceRegistry &registry,
+		float defaultDistance) {
+	const std::vector<std::pair<seq_id_t, std::string>> &genomes = registry.get_genomes();
+
+	rows = reads.size();
+	columns = genomes.size();
+	uint32_t mark = byteOrderMark;
+	uint32_t version = binaryVersion;
+	matrixOffset = 0;
+
+	std::string header;
+	append_raw(header, "APPSPAMS", 8);
+	append_raw(header, &mark, sizeof(mark));
+	append_raw(header, &version, sizeof(version));
+	append_raw(header, &rows, sizeof(rows));
+	append_raw(header, &columns, sizeof(columns));
+	append_raw(header, &defaultDistance, sizeof(defaultDistance));
+	append_raw(header, &matrixOffset, sizeof(matrixOffset));		// Placeholder, set below
+
+	for (uint32_t i = 0; i < columns; i++) {
+		append_name(header, genomes[i].first, genomes[i].second);
+		genomeIDsToColumns[genomes[i].first] = i;
+	}
+	for (uint32_t i = 0; i < rows; i++) {
+		append_name(header, reads[i].get_seqID(), reads[i].get_header());
+		readIDsToRows[reads[i].get_seqID()] = i;
+	}
+	header.resize((header.size() + 7) / 8 * 8, '\0');
+	matrixOffset = header.size();
+	std::memcpy(&header[28], &matrixOffset, sizeof(matrixOffset));
+
+	fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 or !pwrite_all(fd, header.data(), header.size(), 0) or
+			ftruncate(fd, matrixOffset + (uint64_t) rows * columns * sizeof(float)) != 0) {
+		std::cerr << "ERROR: Could not write scoring file: " << filename << std::endl;
+		exit (EXIT_FAILURE);
+	}
+}
+
+ScoringWriter::~ScoringWriter() {
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+/**
+ * Fill rows of all given reads densely and write consecutive rows with one call.
+ * Pairs without distance are stored as NaN. Rows of different reads never overlap,
+ * so partitions can write concurrently.
+ */
+void ScoringWriter::write_rows(Scoring &scoring, std::vector<seq_id_t> &readIDs) {
+	if (columns == 0) {
+		return;
+	}
+	size_t blockRows = std::max((size_t) 1, rowBufferSize / columns);
+	std::vector<float> block;
+
+	for (size_t start = 0; start < readIDs.size(); start += blockRows) {
+		size_t end = std::min(readIDs.size(), start + blockRows);
+		block.assign((end - start) * columns, std::numeric_limits<float>::quiet_NaN());
+
+		for (size_t i = start; i < end; i++) {
+			auto read_it = scoring.scoringMap.find(readIDs[i]);
+			if (read_it == scoring.scoringMap.end()) {
+				continue;
+			}
+			float *row = &block[(i - start) * columns];
+			for (auto const &genome : read_it->second) {
+				auto column_it = genomeIDsToColumns.find(genome.first);
+				if (column_it != genomeIDsToColumns.end()) {
+					row[column_it->second] = genome.second;
+				}
+			}
+		}
+
+		// Write runs of consecutive rows at once
+		size_t i = start;
+		while (i < end) {
+			uint32_t firstRow = readIDsToRows.at(readIDs[i]);
+			size_t j = i + 1;
+			while (j < end and readIDsToRows.at(readIDs[j]) == firstRow + (j - i)) {
+				j++;
+			}
+			if (!pwrite_all(fd, reinterpret_cast<const char*>(&block[(i - start) * columns]), (j - i) * columns * sizeof(float),
+					matrixOffset + (uint64_t) firstRow * columns * sizeof(float))) {
+				std::cerr << "ERROR: Could not write distances to scoring file." << std::endl;
+				exit (EXIT_FAILURE);
+			}
+			i = j;
+		}
+	}
+}
+
+/**
+ * Convert binary scoring file to scoring_table.txt and scoring_list.txt.
+ */
+bool ScoringWriter::convert_to_text(std::string binaryfname, std::string outfoldername) {
+	std::ifstream in(binaryfname, std::ios::binary);
+	char magic[8];
+	uint32_t mark = 0, version = 0, rows = 0, columns = 0;
+	float defaultDistance = 0;
+	uint64_t matrixOffset = 0;
+
+	in.read(magic, 8);
+	in.read(reinterpret_cast<char*>(&mark), sizeof(mark));
+	if (in and std::memcmp(magic, "APPSPAMS", 8) == 0 and mark == __builtin_bswap32(byteOrderMark)) {
+		std::cerr << "ERROR: Binary scoring file was written on a machine with different byte order: " << binaryfname << std::endl;
+		return false;
+	}
+	in.read(reinterpret_cast<char*>(&version), sizeof(version));
+	if (!in or std::memcmp(magic, "APPSPAMS", 8) != 0 or mark != byteOrderMark or version != binaryVersion) {
+		std::cerr << "ERROR: Not a binary scoring file of this version: " << binaryfname << std::endl;
+		return false;
+	}
+	in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+	in.read(reinterpret_cast<char*>(&columns), sizeof(columns));
+	in.read(reinterpret_cast<char*>(&defaultDistance), sizeof(defaultDistance));
+	in.read(reinterpret_cast<char*>(&matrixOffset), sizeof(matrixOffset));
+
+	std::vector<uint32_t> ids(columns + rows);
+	std::vector<std::string> names(columns + rows);
+	for (size_t i = 0; i < ids.size() and in; i++) {
+		uint32_t size = 0;
+		in.read(reinterpret_cast<char*>(&ids[i]), sizeof(uint32_t));
+		in.read(reinterpret_cast<char*>(&size), sizeof(size));
+		names[i].resize(size);
+		in.read(&names[i][0], size);
+	}
+	in.seekg(matrixOffset);
+	if (!in) {
+		std::cerr << "ERROR: Binary scoring file is truncated: " << binaryfname << std::endl;
+		return false;
+	}
+
+	std::ofstream table(outfoldername + "scoring_table.txt");
+	std::ofstream list(outfoldername + "scoring_list.txt");
+	for (uint32_t j = 0; j < columns; j++) {
+		table << "\t" << names[j];
+	}
+	table << "\n";
+
+	std::vector<float> row(columns);
+	for (uint32_t i = 0; i < rows; i++) {
+		if (!in.read(reinterpret_cast<char*>(row.data()), columns * sizeof(float))) {
+			std::cerr << "ERROR: Binary scoring file is truncated: " << binaryfname << std::endl;
+			return false;
+		}
+		table << names[columns + i];
+		for (uint32_t j = 0; j < columns; j++) {
+			if (std::isnan(row[j])) {
+				table << "\t" << defaultDistance;
+			}
+			else {
+				table << "\t" << row[j];
+				list << ids[columns + i] << "\t" << ids[j] << "\t" << row[j] << "\n";
+			}
+		}
+		table << "\n";
+	}
+	return true;
+}
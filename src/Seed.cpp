@@ -31,7 +31,7 @@ Seed::Seed(int32_t weight, int32_t dontCare) {
 /**
  * Generates a pattern suitable for the dataset.
  */
-bool Seed::generate_pattern(std::string &patternStr) {
+bool Seed::generate_pattern(std::string &patternStr, bool verbose) {
 	for(int i = 0; i < patternStr.length(); i++) {
 		if (patternStr[uint(i)] == '1') {
 			matchPos.push_back(i);
@@ -40,7 +40,7 @@ bool Seed::generate_pattern(std::string &patternStr) {
 		}
 	}
 
-	if (fswm_params::g_verbose) {
+	if (verbose) {
 		std::cout << "\tGenerated pattern with weight " << weight << " and length " << length << "." << std::endl;
 		std::cout << "\t\tPattern: " << patternStr << std::endl;
 	}
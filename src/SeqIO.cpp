@@ -24,10 +24,9 @@
 #include <algorithm>
 #include "SeqIO.h"
 
-seq_id_t SeqIO::seqID_counter = -1;
-
 // Read sequence from fasta file 'filename'
-void SeqIO::read_sequences(std::string fastafname, std::vector<Sequence> &sequences, bool genomes) {
+void SeqIO::read_sequences(std::string fastafname, std::vector<Sequence> &sequences, bool genomes, SequenceRegistry &registry,
+        const Parameters &params) {
     std::ifstream fastafstream(fastafname);
     std::string line;
     std::string read;
@@ -41,34 +40,26 @@ void SeqIO::read_sequences(std::string fastafname, std::vector<Sequence> &sequen
             header = header.substr(0, header.find(' '));
             std::getline(fastafstream, line, '>');
 
-            if (!fswm_params::g_draftGenomes) {
-                SeqIO::seqID_counter++;
-                if (fswm_internal::seqIDsToNames.find(SeqIO::seqID_counter) != fswm_internal::seqIDsToNames.end() or fswm_internal::namesToSeqIDs.find(header) != fswm_internal::namesToSeqIDs.end()) {
+            if (!params.draftGenomes) {
+                seq_id_t seqID = registry.new_seqID();
+                if (registry.has_sequence(header)) {
                     std::cerr << "Multiple sequences in the genomes seem to have the same name. Please fix: " << header << std::endl;
                     exit(EXIT_FAILURE);
                 }
                 else {
-                    fswm_internal::seqIDsToNames[SeqIO::seqID_counter] = header;
-                    fswm_internal::namesToSeqIDs[header] = SeqIO::seqID_counter;
-                    fswm_internal::genomeIDsToNames[SeqIO::seqID_counter] = header;
-                    fswm_internal::namesToGenomeIDs[header] = SeqIO::seqID_counter;
-                    sequences.push_back(Sequence(header, line, SeqIO::seqID_counter));
-                    fswm_internal::g_numberGenomes += 1;
+                    registry.register_genome(seqID, header);
+                    sequences.push_back(Sequence(header, line, seqID));
                 }
             }
             else {
-                header = header.substr(0, header.find(fswm_params::g_delimiter));
-                if (fswm_internal::namesToSeqIDs.find(header) != fswm_internal::namesToSeqIDs.end()) {
-                    sequences.push_back(Sequence(header, line, SeqIO::seqID_counter));
+                header = header.substr(0, header.find(params.delimiter));
+                if (registry.has_sequence(header)) {
+                    sequences.push_back(Sequence(header, line, registry.get_lastSeqID()));
                 }
                 else {
-                    SeqIO::seqID_counter++;
-                    fswm_internal::seqIDsToNames[SeqIO::seqID_counter] = header;
-                    fswm_internal::namesToSeqIDs[header] = SeqIO::seqID_counter;
-                    fswm_internal::genomeIDsToNames[SeqIO::seqID_counter] = header;
-                    fswm_internal::namesToGenomeIDs[header] = SeqIO::seqID_counter;
-                    sequences.push_back(Sequence(header, line, SeqIO::seqID_counter));
-                    fswm_internal::g_numberGenomes += 1;
+                    seq_id_t seqID = registry.new_seqID();
+                    registry.register_genome(seqID, header);
+                    sequences.push_back(Sequence(header, line, seqID));
                 }
             }
 
@@ -79,10 +70,10 @@ void SeqIO::read_sequences(std::string fastafname, std::vector<Sequence> &sequen
         std::getline(fastafstream, line, '>');
         while (!fastafstream.eof()) {
             std::getline(fastafstream, header);
-            SeqIO::seqID_counter++;
+            seq_id_t seqID = registry.new_seqID();
             header = header.substr(0, header.find(' '));
             std::getline(fastafstream, line, '>');
-            sequences.push_back(Sequence(header, line, SeqIO::seqID_counter));
+            sequences.push_back(Sequence(header, line, seqID));
         }
     }
 
@@ -61,8 +61,9 @@ Sequence::Sequence(std::string &header, std::string &seqLine, seq_id_t seqID) {
 
 /**
  * Go through sequence and fill buckets with spaced words in sequence.
+ * With sampling (in params) only words with a small hash are inserted.
  */
-void Sequence::fill_buckets(std::vector<Seed> &seeds, BucketManager &bucketManager) {
+void Sequence::fill_buckets(std::vector<Seed> &seeds, BucketManager &bucketManager, const Parameters &params) {
 
 	const size_t NumBytes = 8;
 
@@ -71,7 +72,7 @@ void Sequence::fill_buckets(std::vector<Seed> &seeds, BucketManager &bucketManag
 		std::vector<int> dontCarePos = seed.get_dontCarePos();
 
 	// Go through all spaced words in sequence and save to bucket
-	uint32_t go_until = std::max(int(seq.size() - fswm_params::g_weight - fswm_params::g_spaces + 1), 0);
+	uint32_t go_until = std::max(int(seq.size() - seed.get_length() + 1), 0);
 	for (uint32_t i = 0; i < go_until; i++) {
 		// Create spaced word at position i and give word to BucketManager for further processing
 		word_t matches = 0;
@@ -87,9 +88,9 @@ void Sequence::fill_buckets(std::vector<Seed> &seeds, BucketManager &bucketManag
 			dontCares += seq[i+pos];
 		}
 
-		if (fswm_params::g_sampling) {
+		if (params.sampling) {
 			auto res = crc32_fast(&matches, NumBytes);
-			if (res < fswm_params::g_minHashLowerLimit) {
+			if (res < params.minHashLowerLimit) {
 				Word newWord = Word(seqID, i, matches, dontCares);
 				bucketManager.insert_word(newWord);
 			}
@@ -116,9 +117,9 @@ void Sequence::fill_buckets(std::vector<Seed> &seeds, BucketManager &bucketManag
 			dontCares += seqRev[i+pos];
 		}
 
-		if (fswm_params::g_sampling) {
+		if (params.sampling) {
 			auto res = crc32_fast(&matches, NumBytes);
-			if (res < fswm_params::g_minHashLowerLimit) {
+			if (res < params.minHashLowerLimit) {
 				Word newWord = Word(seqID, i, matches, dontCares);
 				bucketManager.insert_word(newWord);
 			}
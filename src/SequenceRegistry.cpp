@@ -0,0 +1,33 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+
+#include "SequenceRegistry.h"
+
+SequenceRegistry::SequenceRegistry() {
+	this->lastSeqID = -1;
+}
+
+void SequenceRegistry::register_sequence(seq_id_t seqID, const std::string &name) {
+	namesToSeqIDs[name] = seqID;
+}
+
+/** Genomes get increasing IDs, so genomeIDsToNames stays ordered by ID. */
+void SequenceRegistry::register_genome(seq_id_t seqID, const std::string &name) {
+	register_sequence(seqID, name);
+	genomeIDsToNames.push_back(std::make_pair(seqID, name));
+	namesToGenomeIDs[name] = seqID;
+}
@@ -0,0 +1,169 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include "Simulator.h"
+
+static const char nucleotides[] = "ACGT";
+
+Simulator::Simulator(unsigned seed) : generator(seed) {
+	root = -1;
+}
+
+/**
+ * Leaves are the nodes 0 to leaves-1 and named ref0, ref1, ..., internal nodes follow, the root is last.
+ */
+void Simulator::simulate_tree(int leaves, double meanBranchLength) {
+	std::exponential_distribution<double> lengthDist(1 / meanBranchLength);
+	nodes.clear();
+
+	std::vector<int> subtrees;
+	for (int i = 0; i < leaves; i++) {
+		nodes.push_back(SimulatedNode {-1, {}, lengthDist(generator), "ref" + std::to_string(i), 0});
+		subtrees.push_back(i);
+	}
+	while (subtrees.size() > 1) {
+		std::uniform_int_distribution<size_t> subtreeDist(0, subtrees.size() - 1);
+		size_t first = subtreeDist(generator);
+		std::swap(subtrees[first], subtrees.back());
+		size_t second = std::uniform_int_distribution<size_t>(0, subtrees.size() - 2)(generator);
+
+		int parent = nodes.size();
+		nodes.push_back(SimulatedNode {-1, {subtrees[second], subtrees.back()}, lengthDist(generator), "", 0});
+		nodes[subtrees[second]].parent = parent;
+		nodes[subtrees.back()].parent = parent;
+		subtrees[second] = parent;
+		subtrees.pop_back();
+	}
+	root = subtrees.empty() ? -1 : subtrees[0];
+	if (root >= 0) {
+		nodes[root].length = 0;
+		number_edges(root, 0);
+	}
+}
+
+/** Number edges in post-order as in the JPlace tree of appspam. */
+uint32_t Simulator::number_edges(int node, uint32_t count) {
+	for (auto const child : nodes[node].children) {
+		count = number_edges(child, count);
+	}
+	nodes[node].edge = count;
+	return count + 1;
+}
+
+std::string Simulator::evolve(const std::string &seq, double t) {
+	// Probability that a site changes to one of the three other nucleotides
+	double change = 0.75 * (1 - std::exp(-4.0 / 3.0 * t));
+	std::bernoulli_distribution changeDist(change);
+	std::uniform_int_distribution<int> otherDist(1, 3);
+
+	std::string evolved = seq;
+	for (auto &c : evolved) {
+		if (changeDist(generator)) {
+			int base = std::find(nucleotides, nucleotides + 4, c) - nucleotides;
+			c = nucleotides[(base + otherDist(generator)) % 4];
+		}
+	}
+	return evolved;
+}
+
+void Simulator::evolve_sequences(int length) {
+	sequences.assign(nodes.size(), "");
+	if (root < 0) {
+		return;
+	}
+
+	std::uniform_int_distribution<int> baseDist(0, 3);
+	sequences[root].resize(length);
+	for (auto &c : sequences[root]) {
+		c = nucleotides[baseDist(generator)];
+	}
+
+	// Parents always have higher indices than their children
+	for (int i = root - 1; i >= 0; i--) {
+		sequences[i] = evolve(sequences[nodes[i].parent], nodes[i].length);
+	}
+}
+
+std::vector<SimulatedQuery> Simulator::simulate_queries(int count, int length, double meanPendantLength) {
+	std::vector<SimulatedQuery> queries;
+	if (root <= 0 or sequences.empty()) {
+		return queries;
+	}
+	length = std::min<int>(length, sequences[root].size());
+
+	std::uniform_int_distribution<int> nodeDist(0, root - 1);
+	std::uniform_int_distribution<int> startDist(0, sequences[root].size() - length);
+	std::uniform_real_distribution<double> positionDist(0, 1);
+	std::exponential_distribution<double> pendantDist(1 / meanPendantLength);
+
+	for (int i = 0; i < count; i++) {
+		int node = nodeDist(generator);
+		double toParent = positionDist(generator) * nodes[node].length;
+		double pendant = pendantDist(generator);
+		std::string fragment = sequences[nodes[node].parent].substr(startDist(generator), length);
+
+		queries.push_back(SimulatedQuery {"query" + std::to_string(i), evolve(fragment, toParent + pendant),
+				nodes[node].edge, nodes[node].length - toParent, pendant});
+	}
+	return queries;
+}
+
+std::string Simulator::get_newick_recurse(int node) const {
+	std::stringstream newick;
+	if (!nodes[node].children.empty()) {
+		newick << "(" << get_newick_recurse(nodes[node].children[0]) << "," << get_newick_recurse(nodes[node].children[1]) << ")";
+	}
+	newick << nodes[node].name;
+	if (node != root) {
+		newick << ":" << nodes[node].length;
+	}
+	return newick.str();
+}
+
+std::string Simulator::get_newick() const {
+	return root < 0 ? ";" : get_newick_recurse(root) + ";";
+}
+
+bool Simulator::write_references(std::string filename) const {
+	std::ofstream references(filename);
+	for (size_t i = 0; i < nodes.size() and i < sequences.size(); i++) {
+		if (nodes[i].children.empty()) {
+			references << ">" << nodes[i].name << "\n" << sequences[i] << "\n";
+		}
+	}
+	return references.good();
+}
+
+bool Simulator::write_tree(std::string filename) const {
+	std::ofstream tree(filename);
+	tree << get_newick() << "\n";
+	return tree.good();
+}
+
+bool Simulator::write_edges(std::string filename) const {
+	std::ofstream edges(filename);
+	edges << "edge\tparent_edge\tlength\tname\n";
+	for (auto const &node : nodes) {
+		edges << node.edge << "\t" << (node.parent < 0 ? -1 : (int64_t) nodes[node.parent].edge) << "\t"
+			  << node.length << "\t" << node.name << "\n";
+	}
+	return edges.good();
+}
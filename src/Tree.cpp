@@ -17,6 +17,9 @@
 #include <iostream>
 #include <fstream>
 #include <math.h>
+#include <cmath>
+#include <algorithm>
+#include <functional>
 #include <limits>
 #include <unordered_set>
 #include <string>
@@ -26,8 +29,8 @@
 /**
  * Create tree from newick file.
  */
-Tree::Tree(std::string filename) {
-	root = new Node("internal_1");
+Tree::Tree(std::string filename, SequenceRegistry &registry, const Parameters &params) : params(params) {
+	root = new Node("internal_1", registry);
 	internalNodeCounter = 1;
 	is_rooted = true;
 
@@ -36,7 +39,7 @@ Tree::Tree(std::string filename) {
 
 	if (newickFile.is_open()) {
 		newickFile >> line;
-		parse_newick_tree(line);
+		parse_newick_tree(line, registry);
 	}
 	else {
 		std::cout << "Tree file does not exist or is not correctly formatted." << std::endl;
@@ -48,9 +51,19 @@ Tree::Tree(std::string filename) {
 	dfs_iterator = dfs_iterator_recurse(root);
 	bfs_iterator = bfs_iterator_recurse(root);
 	leave_iterator = leave_iterator_recurse(root);
+
+	std::unordered_map<Node*, int> nodeToDfsIndex;
+	dfsChildIndices.resize(dfs_iterator.size());
+	for (size_t i = 0; i < dfs_iterator.size(); i++) {
+		nodeToDfsIndex[dfs_iterator[i]] = i;
+		idsToNodes[dfs_iterator[i]->ID] = dfs_iterator[i];
+		for (auto const &child : dfs_iterator[i]->children) {
+			dfsChildIndices[i].push_back(nodeToDfsIndex[child]);
+		}
+	}
 }
 
-bool Tree::parse_newick_tree(std::string treeStr) {
+bool Tree::parse_newick_tree(std::string treeStr, SequenceRegistry &registry) {
 	std::string nodeName = "";
 	std::string distance = "";
 	Node *currentNode_pt = root;
@@ -60,7 +73,7 @@ bool Tree::parse_newick_tree(std::string treeStr) {
 		if (!std::isspace(*it)) {
 			switch(*it) {
 				case '(': {
-					Node* temp = new Node("internal_" + std::to_string(++internalNodeCounter));
+					Node* temp = new Node("internal_" + std::to_string(++internalNodeCounter), registry);
 					currentNode_pt->add_child(temp);
 					currentNode_pt = temp;
 					break;
@@ -100,8 +113,8 @@ bool Tree::parse_newick_tree(std::string treeStr) {
 					it--;
 
 					if (createNewNode) {
-						Node* temp = new Node(nodeName);	// create new leave node and name it
-						if (fswm_internal::namesToGenomeIDs.find(nodeName) == fswm_internal::namesToGenomeIDs.end()) {
+						Node* temp = new Node(nodeName, registry);	// create new leave node and name it
+						if (!registry.has_genome(nodeName)) {
 							std::cerr << "The following sequence name is in the tree, but not in the references: " << nodeName  << std::endl;
 							exit (EXIT_FAILURE);
 						}
@@ -117,7 +130,7 @@ bool Tree::parse_newick_tree(std::string treeStr) {
 	}
 	// Check if tree is unrooted an root arbitrarily at lowest level
 	if (root->children.size() > 2) {
-		if (fswm_params::g_verbose) { std::cout << "\tThe input tree is unrooted, please use a rooted tree."
+		if (params.verbose) { std::cout << "\tThe input tree is unrooted, please use a rooted tree."
 			"\n\tThe tree will be rooted at the implicit trifurcating root now." << std::endl; }
 
 		// Save children that will be below new subtree and remove from children
@@ -126,7 +139,7 @@ bool Tree::parse_newick_tree(std::string treeStr) {
 		root->children.erase(root->children.begin()+1,root->children.begin()+3);
 
 		// Create new internal node
-		Node* temp = new Node("internal_" + std::to_string(++internalNodeCounter));
+		Node* temp = new Node("internal_" + std::to_string(++internalNodeCounter), registry);
 		root->add_child(temp);
 		currentNode_pt = temp;
 
@@ -282,6 +295,166 @@ seq_id_t Tree::get_LCA_best_count_exp(countMap_t::iterator &it, double div) {
 	return find_LCA(std::vector<seq_id_t> {first_id, second_id})->ID;
 }
 
+/**
+ * Weighted sums over a set of leaves, used for least-squares placement. For leaves i with
+ * weight w_i, query distance d_i and tree distance D_i to a fixed node the sums are
+ * w_i, w_i*d_i, w_i*d_i^2, w_i*D_i, w_i*D_i^2 and w_i*d_i*D_i.
+ */
+struct LeastSquaresSums {
+	double w = 0, wd = 0, wd2 = 0, wD = 0, wD2 = 0, wdD = 0;
+
+	// Add sums of other node that is 'length' further away.
+	void add_shifted(const LeastSquaresSums &other, double length) {
+		w += other.w;
+		wd += other.wd;
+		wd2 += other.wd2;
+		wD += other.wD + length * other.w;
+		wD2 += other.wD2 + 2 * length * other.wD + length * length * other.w;
+		wdD += other.wdD + length * other.wd;
+	}
+};
+
+/**
+ * Place read on the edge that minimizes the weighted least-squares error between query-reference
+ * distances and tree path lengths (Fitch-Margoliash weighting, as in APPLES). For every edge the
+ * optimal distal and pendant lengths are solved in closed form from sums over the leaves below and
+ * above the edge, which are computed in one post- and one pre-order traversal.
+ */
+seq_id_t Tree::get_least_squares_placement(scoringMap_t::iterator &it, double &distal_length, double &pendant_length) {
+	const double min_distance = 1e-5;
+	const int n = dfs_iterator.size();
+	std::vector<LeastSquaresSums> below(n);		// Leaves below node, distances measured from node
+	std::vector<LeastSquaresSums> above(n);		// Leaves not below node, distances measured from its parent
+
+	for (int i = 0; i < n; i++) {				// Post-order: children before parents
+		Node* node = dfs_iterator[i];
+		if (node->children.empty()) {
+			double d = params.defaultDistance;
+			auto dist_it = it->second.find(node->ID);
+			if (dist_it != it->second.end() and std::isfinite(dist_it->second)) {
+				d = dist_it->second;
+			}
+			double w = 1.0 / (std::max(d, min_distance) * std::max(d, min_distance));
+			below[i].w = w;
+			below[i].wd = w * d;
+			below[i].wd2 = w * d * d;
+		}
+		for (auto const child : dfsChildIndices[i]) {
+			below[i].add_shifted(below[child], dfs_iterator[child]->distance);
+		}
+	}
+
+	double best_error = std::numeric_limits<double>::max();
+	seq_id_t best_id = get_rootID();
+	distal_length = 0;
+	pendant_length = params.defaultDistanceNewLeaves;
+
+	for (int i = n - 1; i >= 0; i--) {			// Pre-order: parents before children
+		for (auto const child : dfsChildIndices[i]) {
+			if (dfs_iterator[i] != root) {
+				above[child].add_shifted(above[i], dfs_iterator[i]->distance);
+			}
+			for (auto const sibling : dfsChildIndices[i]) {
+				if (sibling != child) {
+					above[child].add_shifted(below[sibling], dfs_iterator[sibling]->distance);
+				}
+			}
+
+			// Query is attached at distance x from child and with pendant length l, residuals
+			// are r = d - D - x - l for leaves below and s = d - D - (L - x) - l for leaves above.
+			const double L = dfs_iterator[child]->distance;
+			const LeastSquaresSums &B = below[child];
+			const LeastSquaresSums &A = above[child];
+			double R = B.wd - B.wD;
+			double R2 = B.wd2 - 2 * B.wdD + B.wD2;
+			double S = A.wd - A.wD - L * A.w;
+			double S2 = A.wd2 - 2 * A.wdD + A.wD2 - 2 * L * (A.wd - A.wD) + L * L * A.w;
+
+			double x = 0;
+			double l = R / B.w;
+			if (A.w > 0) {
+				x = (R / B.w - S / A.w) / 2;
+			}
+			x = std::min(std::max(x, 0.0), L);
+			l = (R - x * B.w + S + x * A.w) / (B.w + A.w);
+			if (l < 0) {						// Negative pendant lengths are not allowed
+				l = 0;
+				x = std::min(std::max((R - S) / (B.w + A.w), 0.0), L);
+			}
+
+			double error = R2 - 2 * (l + x) * R + (l + x) * (l + x) * B.w
+			             + S2 - 2 * (l - x) * S + (l - x) * (l - x) * A.w;
+			if (error < best_error) {
+				best_error = error;
+				best_id = dfs_iterator[child]->ID;
+				distal_length = x;
+				pendant_length = l;
+			}
+		}
+	}
+
+	return best_id;
+}
+
+/**
+ * Return up to n weighted placements for a read, starting with the node chosen by the assignment mode.
+ * References are ranked by spaced word counts (count based modes) or by inverse distances (distance
+ * based modes). References below the chosen node add to its weight, the next best other references
+ * become additional placements. Weights are normalized to sum up to one.
+ */
+std::vector<std::pair<seq_id_t, double>> Tree::get_weighted_placements(seq_id_t placementID, scoringMap_t::iterator &scoringMap_it,
+		countMap_t::iterator &countMap_it, uint32_t n) {
+	std::vector<std::pair<double, seq_id_t>> ranked;
+	if (params.assignmentMode == "MINDIST" or params.assignmentMode == "LCADIST") {
+		for (auto const &seqIDtoScoring : scoringMap_it->second) {
+			ranked.push_back(std::pair<double, seq_id_t> (1.0 / std::max(seqIDtoScoring.second, 1e-5), seqIDtoScoring.first));
+		}
+	}
+	else {
+		for (auto const &seqIDtoCount : countMap_it->second) {
+			ranked.push_back(std::pair<double, seq_id_t> (seqIDtoCount.second, seqIDtoCount.first));
+		}
+	}
+	std::sort(ranked.begin(), ranked.end(), std::greater<std::pair<double, seq_id_t>>());
+
+	std::vector<std::pair<seq_id_t, double>> placements {std::pair<seq_id_t, double> (placementID, 0)};
+	Node* placementNode = find_node(placementID);
+	double sum_weights = 0;
+
+	for (auto const &reference : ranked) {
+		if (!std::isfinite(reference.first) or reference.first <= 0) {
+			continue;
+		}
+
+		bool below_placement = false;
+		for (Node* node = find_node(reference.second); node != nullptr; node = node->parent) {
+			if (node == placementNode) {
+				below_placement = true;
+				break;
+			}
+		}
+
+		if (below_placement) {
+			placements[0].second += reference.first;
+		}
+		else if (placements.size() < n) {
+			placements.push_back(std::pair<seq_id_t, double> (reference.second, reference.first));
+		}
+		else {
+			continue;
+		}
+		sum_weights += reference.first;
+	}
+
+	if (sum_weights <= 0) {
+		return std::vector<std::pair<seq_id_t, double>> {std::pair<seq_id_t, double> (placementID, 1)};
+	}
+	for (auto &placement : placements) {
+		placement.second /= sum_weights;
+	}
+	return placements;
+}
+
 /** Return LCA of top n nodes with smallest similarity scores. */
 seq_id_t Tree::get_LCA_best_score(scoringMap_t::iterator &it) {
 	std::vector<std::pair<scoring_t, seq_id_t>> minimal_scores;
@@ -368,10 +541,9 @@ Node* Tree::find_LCA(std::unordered_set<seq_id_t> leaves) {
 
 /** Return pointer to node with ID */
 Node* Tree::find_node(seq_id_t seqID) {
-	for (auto node : dfs_iterator) {
-		if (node->ID == seqID) {
-			return node;
-		}
+	auto node_it = idsToNodes.find(seqID);
+	if (node_it != idsToNodes.end()) {
+		return node_it->second;
 	}
 	std::cerr << "Could not find node with the given node ID in tree: " << seqID  << std::endl;
 	exit (EXIT_FAILURE);
@@ -557,6 +729,18 @@ std::string Tree::get_newick_str(bool write_edge_nums = true) {
 	return outputTreeStream.str();;
 }
 
+/** Record JPlace edge number of a node in both directions. */
+void Tree::set_placementID(seq_id_t nodeID, int count) {
+	if (IDsToPlacementIDs.size() <= nodeID) {
+		IDsToPlacementIDs.resize(nodeID + 1, 0);
+	}
+	if (placementIDsToIDs.size() <= (size_t) count) {
+		placementIDsToIDs.resize(count + 1, 0);
+	}
+	IDsToPlacementIDs[nodeID] = count;
+	placementIDsToIDs[count] = nodeID;
+}
+
 /** Helper function for get_newick_str(). */
 int Tree::get_newick_str_recurse(std::stringstream &outputTreeStream, Node *node, int count, bool write_edge_nums = true) {
 	if (!node->children.empty()) {
@@ -571,8 +755,7 @@ int Tree::get_newick_str_recurse(std::stringstream &outputTreeStream, Node *node
 		if (write_edge_nums) {
 			outputTreeStream << "{" << count << "}";
 		}
-		fswm_internal::IDsToPlacementIDs[node->ID] = count;
-		fswm_internal::placementIDsToIDs[count] = node->ID;
+		set_placementID(node->ID, count);
 		count++;
 	}
 	else {
@@ -580,8 +763,7 @@ int Tree::get_newick_str_recurse(std::stringstream &outputTreeStream, Node *node
 		if (write_edge_nums) {
 			outputTreeStream << "{" << count << "}";
 		}
-		fswm_internal::IDsToPlacementIDs[node->ID] = count;
-		fswm_internal::placementIDsToIDs[count] = node->ID;
+		set_placementID(node->ID, count);
 		count++;
 	}
 	return count;
@@ -593,91 +775,100 @@ seq_id_t Tree::get_rootID() {
 }
 
 /** Write metainformation of jplace file, such as version, fields, metadata, tree. */
-void Tree::write_jplace_data_beginning() {
-	std::ofstream jPlaceFile;
-	jPlaceFile.open(fswm_params::g_outfoldername + fswm_params::g_outjplacename);
-	jPlaceFile << "{\n\t\"version\":3,\n\t"
-		"\"fields\":[\"edge_num\",\"distal_length\",\"pendant_length\",\"like_weight_ratio\",\"likelihood\"],\n"
-		"\t\"metadata\":{\n"
+void Tree::write_jplace_data_beginning(PlacementWriter &writer) {
+	std::string metadata =
 			"\t\t\"software\"\t:\t\"App-SpaM\",\n"
 			"\t\t\"More info\"\t:\t\"https://github.com/matthiasblanke/APP-SpaM\",\n\n"
-			"\t\t\"reference_fasta\"\t:\t\"" + fswm_params::g_genomesfname + "\",\n"
-			"\t\t\"tree_newick\"\t:\t\"" + fswm_params::g_reftreefname + "\",\n"
-			"\t\t\"query_fasta\"\t:\t\"" + fswm_params::g_readsfname + "\",\n"
-			"\t\t\"number of patterns\"\t:\t" + std::to_string(fswm_params::g_numPatterns) + ",\n"
-			"\t\t\"weight\"\t:\t" + std::to_string(fswm_params::g_weight) + ",\n"
-			"\t\t\"dont cares\"\t:\t" + std::to_string(fswm_params::g_spaces) + ",\n"
-			"\t\t\"mode\"\t:\t\"" + fswm_params::g_assignmentMode + "\",\n"
-			"\t\t\"filtering threshold\"\t:\t" + std::to_string(fswm_params::g_filteringThreshold) + ",\n"
-			"\t\t\"sampling\"\t:\t" + std::to_string(fswm_params::g_sampling) + ",\n"
-			"\t\t\"minHashLowerLimit\"\t:\t" + std::to_string(fswm_params::g_minHashLowerLimit) + ",\n"
-			"\t\t\"unassembled\"\t:\t" + std::to_string(fswm_params::g_draftGenomes) + ",\n"
-			"\t\t\"delimiter\"\t:\t\"" + fswm_params::g_delimiter + "\"\n"
-			"\t},\n\t"
-		"\"tree\":\"" + get_newick_str() + "\",\n"
-		"\t\"placements\":\n"
-		"\t[\n";
-
-	jPlaceFile.close();
+			+ (params.indexfoldername.empty() ? "\t\t\"reference_fasta\"\t:\t\"" + PlacementWriter::json_escape(params.genomesfname) + "\",\n"
+					: "\t\t\"reference_index\"\t:\t\"" + PlacementWriter::json_escape(params.indexfoldername) + "\",\n") +
+			"\t\t\"tree_newick\"\t:\t\"" + PlacementWriter::json_escape(params.reftreefname) + "\",\n"
+			"\t\t\"query_fasta\"\t:\t\"" + PlacementWriter::json_escape(params.readsfname) + "\",\n"
+			"\t\t\"number of patterns\"\t:\t" + std::to_string(params.numPatterns) + ",\n"
+			"\t\t\"weight\"\t:\t" + std::to_string(params.weight) + ",\n"
+			"\t\t\"dont cares\"\t:\t" + std::to_string(params.spaces) + ",\n"
+			"\t\t\"mode\"\t:\t\"" + PlacementWriter::json_escape(params.assignmentMode) + "\",\n"
+			"\t\t\"filtering threshold\"\t:\t" + std::to_string(params.filteringThreshold) + ",\n"
+			"\t\t\"top k references\"\t:\t" + std::to_string(params.topReferences) + ",\n"
+			"\t\t\"sampling\"\t:\t" + std::to_string(params.sampling) + ",\n"
+			"\t\t\"minHashLowerLimit\"\t:\t" + std::to_string(params.minHashLowerLimit) + ",\n"
+			"\t\t\"unassembled\"\t:\t" + std::to_string(params.draftGenomes) + ",\n"
+			"\t\t\"delimiter\"\t:\t\"" + PlacementWriter::json_escape(params.delimiter) + "\"\n";
+
+	writer.write_beginning(metadata, get_newick_str());
 }
 
 /** Write closing brackets after placement data to jplace file. */
-void Tree::write_jplace_data_end() {
-	std::ofstream jPlaceFile;
-	jPlaceFile.open(fswm_params::g_outfoldername + fswm_params::g_outjplacename, std::ios_base::app);
-	jPlaceFile << "\t]\n"
-		"}";
-	jPlaceFile.close();
+void Tree::write_jplace_data_end(PlacementWriter &writer) {
+	writer.write_end();
 }
 
-/** For each assigned read, write placement data to jplace file. */
-void Tree::write_jplace_placement_data(std::vector<std::pair<seq_id_t, int>> &readAssignment, scoringMap_t &scoringMap) {
-	std::ofstream jPlaceFile;
-	jPlaceFile.open(fswm_params::g_outfoldername + fswm_params::g_outjplacename, std::ios_base::app);
-
-	int i = 0;
+/** Placements of one assigned read with JPlace edge numbers and distal and pendant branch lengths. */
+std::vector<PlacementRecord> Tree::get_placement_records(const std::pair<seq_id_t, int> &read, scoringMap_t &scoringMap,
+		branchLengthMap_t &branchLengths, placementMap_t &weightedPlacements) {
+	if (params.numPlacements > 1 and weightedPlacements.find(read.first) != weightedPlacements.end()) {
+		return get_multiple_placement_records(weightedPlacements[read.first], read.first, scoringMap);
+	}
 
 	double distal_length = 0;
-	double pendant_length = fswm_params::default_distance_new_leaves;
+	double pendant_length = params.defaultDistanceNewLeaves;
 	double dist_refs = 0;
 	double dist_current_edge = 0;
 
-	for (auto const& read : readAssignment) {
-		if (fswm_internal::jplace_tracking) {
-			;
+	// Determine distal and pendant branch lengths
+	if (params.assignmentMode == "MINDIST" or params.assignmentMode == "SPAMCOUNT") {
+		dist_refs = scoringMap[read.first][read.second];
+		dist_current_edge = find_node(read.second)->distance;
+		if (dist_refs < 2*dist_current_edge) {
+			distal_length = dist_refs / 2;
+			pendant_length = dist_refs / 2;
 		}
 		else {
-			jPlaceFile << ",";
-		}
-		
-		// Determine distal and pendant branch lengths
-		if (fswm_params::g_assignmentMode == "MINDIST" or fswm_params::g_assignmentMode == "SPAMCOUNT") {
-			dist_refs = scoringMap[read.first][read.second];
-			dist_current_edge = find_node(read.second)->distance;
-			if (dist_refs < 2*dist_current_edge) {
+			distal_length = dist_current_edge;
+			pendant_length = dist_refs - dist_current_edge;
+		}
+	}
+	if (params.assignmentMode == "LCACOUNT" or params.assignmentMode == "LCADIST") {
+		distal_length = find_node(read.second)->distance/2; 
+	}
+	if (params.assignmentMode == "APPLES") {
+		distal_length = 0;
+		pendant_length = params.defaultDistanceNewLeaves;
+		if (branchLengths.find(read.first) != branchLengths.end()) {
+			distal_length = branchLengths[read.first].first;
+			pendant_length = branchLengths[read.first].second;
+		}
+	}
+
+	return std::vector<PlacementRecord> {PlacementRecord {IDsToPlacementIDs[read.second], distal_length, pendant_length, 1}};
+}
+
+/** All weighted placements of one read, written as a single placement entry to the jplace file. */
+std::vector<PlacementRecord> Tree::get_multiple_placement_records(std::vector<std::pair<seq_id_t, double>> &placements,
+		seq_id_t seqID, scoringMap_t &scoringMap) {
+	std::vector<PlacementRecord> records;
+
+	for (auto const &placement : placements) {
+		Node* node = find_node(placement.first);
+		double distal_length = node->distance / 2;
+		double pendant_length = params.defaultDistanceNewLeaves;
+
+		// Leaves with a known distance to the read are split as in MINDIST mode
+		auto dist_it = scoringMap[seqID].find(placement.first);
+		if (node->children.empty() and dist_it != scoringMap[seqID].end() and std::isfinite(dist_it->second)) {
+			double dist_refs = dist_it->second;
+			if (dist_refs < 2*node->distance) {
 				distal_length = dist_refs / 2;
 				pendant_length = dist_refs / 2;
 			}
 			else {
-				distal_length = dist_current_edge;
-				pendant_length = dist_refs - dist_current_edge;
+				distal_length = node->distance;
+				pendant_length = dist_refs - node->distance;
 			}
 		}
-		if (fswm_params::g_assignmentMode == "LCACOUNT" or fswm_params::g_assignmentMode == "LCADIST") {
-			distal_length = find_node(read.second)->distance/2; 
-		}
 
-		jPlaceFile << "\t\t{\n"
-					  "\t\t\t\"p\":\n"
-		              "\t\t\t[[" + std::to_string(fswm_internal::IDsToPlacementIDs[read.second]) + "," + 
-		              	std::to_string(distal_length) + "," + std::to_string(pendant_length) + ",1,1]],\n"
-		              "\t\t\t\"nm\":\n"
-		              "\t\t\t[[\"" + fswm_internal::readIDsToNames[read.first] + "\", 1]]\n"
-		              "\t\t}";
-		i++;
-		jPlaceFile << "\n";
-		fswm_internal::jplace_tracking = false;
+		records.push_back(PlacementRecord {IDsToPlacementIDs[placement.first], distal_length, pendant_length,
+			placement.second});
 	}
 
-	jPlaceFile.close();
+	return records;
 }
@@ -0,0 +1,291 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Microbenchmarks of the hot kernels of appspam on synthetic data:
+ * 	fill_buckets, create_wordGroups, fswm_complete, calculate_fswm_distances, find_LCA, jplace_writer.
+ *
+ * References, tree and queries are simulated with Simulator (Jukes-Cantor evolution along
+ * a random rooted tree). All input is created from --seed, so runs with equal parameters
+ * work on identical data.
+ *
+ * Example:
+ * 	./appspam_bench --references 100 --length 20000 --queries 5000 --repeats 5
+ */
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <getopt.h>
+#include <unistd.h>
+#include "GlobalParameters.h"
+#include "Pattern.h"
+#include "Seed.h"
+#include "SeqIO.h"
+#include "Sequence.h"
+#include "BucketManager.h"
+#include "Algorithms.h"
+#include "Scoring.h"
+#include "Tree.h"
+#include "PlacementWriter.h"
+#include "Simulator.h"
+
+struct BenchParameters {
+	int references = 50;
+	int length = 10000;
+	int queries = 2000;
+	int queryLength = 150;
+	double branchLength = 0.05;
+	double pendantLength = 0.02;
+	int repeats = 5;
+	int lcaQueries = 100000;
+	unsigned seed = 1;
+	std::string only = "";
+};
+
+static void print_usage() {
+	std::cout << R""""(
+Execute appspam_bench with:
+	./appspam_bench [parameters]
+
+    -w  --weight            Weight of pattern (default 12).
+    -d  --dontCare          Number of don't care positions (default 32).
+    -p  --pattern           Number of patterns (default 1).
+        --references        Number of references (default 50).
+        --length            Length of each reference (default 10000).
+        --queries           Number of queries (default 2000).
+        --query-length      Length of each query (default 150).
+        --branch-length     Mean branch length of the reference tree (default 0.05).
+        --pendant-length    Mean pendant length of queries (default 0.02).
+        --lca-queries       Number of find_LCA calls (default 100000).
+        --repeats           Repetitions per benchmark, median and minimum
+                            are reported (default 5).
+        --seed              Seed for synthetic data (default 1).
+        --only              Run only the named benchmark.
+)"""";
+}
+
+/** Run benchmark repeats times and print median and minimum time and throughput of items. */
+static void run_benchmark(const BenchParameters &params, std::string name, uint64_t items,
+		std::function<void()> setup, std::function<void()> kernel) {
+	if (!params.only.empty() and params.only != name) {
+		return;
+	}
+
+	std::vector<double> seconds;
+	for (int i = 0; i < params.repeats; i++) {
+		setup();
+		auto start = std::chrono::steady_clock::now();
+		kernel();
+		seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(seconds.begin(), seconds.end());
+	double median = seconds[seconds.size() / 2];
+
+	std::cout << name << "\t" << median * 1000 << "\t" << seconds[0] * 1000 << "\t" << items << "\t"
+			  << (median > 0 ? items / median : 0) << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+	BenchParameters params;
+
+	static struct option long_options[] = {
+		{ "weight", required_argument, 			nullptr, 'w' },
+		{ "dontCare", required_argument, 		nullptr, 'd' },
+		{ "pattern", required_argument, 		nullptr, 'p' },
+		{ "help", no_argument, 					nullptr, 'h' },
+		{ "references", required_argument, 		nullptr, 1   },
+		{ "length", required_argument, 			nullptr, 2   },
+		{ "queries", required_argument, 		nullptr, 3   },
+		{ "query-length", required_argument, 	nullptr, 4   },
+		{ "branch-length", required_argument, 	nullptr, 5   },
+		{ "lca-queries", required_argument, 	nullptr, 6   },
+		{ "repeats", required_argument, 		nullptr, 7   },
+		{ "seed", required_argument, 			nullptr, 8   },
+		{ "only", required_argument, 			nullptr, 9   },
+		{ "pendant-length", required_argument, 	nullptr, 10  },
+		0
+	};
+
+	int option_param, index;
+	while ((option_param = getopt_long(argc, argv, "w:d:p:h", long_options, &index)) != -1) {
+		switch (option_param) {
+			case 'w': fswm_params::g_weight = atoi(optarg); break;
+			case 'd': fswm_params::g_spaces = atoi(optarg); break;
+			case 'p': fswm_params::g_numPatterns = atoi(optarg); break;
+			case 1: params.references = atoi(optarg); break;
+			case 2: params.length = atoi(optarg); break;
+			case 3: params.queries = atoi(optarg); break;
+			case 4: params.queryLength = atoi(optarg); break;
+			case 5: params.branchLength = atof(optarg); break;
+			case 6: params.lcaQueries = atoi(optarg); break;
+			case 7: params.repeats = std::max(1, atoi(optarg)); break;
+			case 8: params.seed = atoi(optarg); break;
+			case 9: params.only = optarg; break;
+			case 10: params.pendantLength = atof(optarg); break;
+			default:
+				print_usage();
+				exit (EXIT_SUCCESS);
+		}
+	}
+	if (params.references < 2 or params.queryLength > params.length) {
+		std::cerr << "ERROR: Use at least 2 references and queries not longer than references." << std::endl;
+		exit (EXIT_FAILURE);
+	}
+
+	Parameters parameters = GlobalParameters::get_parameters();
+
+	// Create synthetic queries, references and tree in a temporary folder.
+	// Queries are read first, as in appspam, so that they get the lowest sequence IDs.
+	Simulator simulator(params.seed);
+	simulator.simulate_tree(params.references, params.branchLength);
+	simulator.evolve_sequences(params.length);
+	std::vector<SimulatedQuery> simulatedQueries = simulator.simulate_queries(params.queries, params.queryLength, params.pendantLength);
+
+	char folder[] = "/tmp/appspam_bench_XXXXXX";
+	if (mkdtemp(folder) == nullptr) {
+		std::cerr << "ERROR: Could not create temporary folder." << std::endl;
+		exit (EXIT_FAILURE);
+	}
+	std::string queriesfname = std::string(folder) + "/queries.fasta";
+	std::string referencesfname = std::string(folder) + "/references.fasta";
+	std::string treefname = std::string(folder) + "/tree.nwk";
+	std::string jplacefname = std::string(folder) + "/placements.jplace";
+
+	std::ofstream queriesFile(queriesfname);
+	for (auto const &query : simulatedQueries) {
+		queriesFile << ">" << query.name << "\n" << query.seq << "\n";
+	}
+	queriesFile.close();
+	simulator.write_references(referencesfname);
+	simulator.write_tree(treefname);
+
+	std::vector<Sequence> queries, genomes;
+	SequenceRegistry registry;
+	SeqIO::read_sequences(queriesfname, queries, false, registry, parameters);
+	SeqIO::read_sequences(referencesfname, genomes, true, registry, parameters);
+	Tree tree(treefname, registry, parameters);
+
+	Pattern pattern = Pattern(parameters.numPatterns, parameters.weight + parameters.spaces, parameters.weight, 0);
+	pattern.Silent();
+	pattern.ImproveSecure();
+	pattern.Improve(10);
+	std::vector<std::string> patterns = pattern.GetPattern();
+	std::vector<Seed> seeds;
+	for (int i = 0; i < parameters.numPatterns; i++) {
+		Seed seed(parameters.weight, parameters.spaces);
+		seed.generate_pattern(patterns[i], parameters.verbose);
+		seeds.push_back(seed);
+	}
+
+	std::cout << "# weight " << parameters.weight << ", don't cares " << parameters.spaces << ", patterns "
+			  << parameters.numPatterns << ", references " << params.references << " x " << params.length
+			  << ", queries " << params.queries << " x " << params.queryLength << ", seed " << params.seed << std::endl;
+	std::cout << "benchmark\tmedian_ms\tmin_ms\titems\titems_per_s" << std::endl;
+
+	// Prepared inputs of all kernels, so every benchmark can also run on its own
+	BucketManager genomeBuckets, queryBuckets;
+	for (auto &genome : genomes) {
+		genome.fill_buckets(seeds, genomeBuckets, parameters);
+	}
+	for (auto &query : queries) {
+		query.fill_buckets(seeds, queryBuckets, parameters);
+	}
+	uint64_t genomeWords = 0;
+	for (auto const minimizer : genomeBuckets.get_minimizers()) {
+		genomeWords += genomeBuckets.get_bucket(minimizer).get_bucketSize();
+	}
+	BucketManager groupedGenomeBuckets = genomeBuckets;
+	BucketManager groupedQueryBuckets = queryBuckets;
+	groupedGenomeBuckets.create_wordGroups();
+	groupedGenomeBuckets.create_groupIndexes();
+	groupedQueryBuckets.create_wordGroups();
+
+	Scoring matched;
+	Algorithms::fswm_complete(groupedGenomeBuckets, groupedQueryBuckets, matched, parameters);
+	uint64_t pairs = 0;
+	for (auto const &read : matched.scoringMap) {
+		pairs += read.second.size();
+	}
+
+	BucketManager buckets;
+	Scoring scoring;
+
+	run_benchmark(params, "fill_buckets", genomeWords,
+		[&]() { buckets = BucketManager(); },
+		[&]() { for (auto &genome : genomes) { genome.fill_buckets(seeds, buckets, parameters); } });
+
+	run_benchmark(params, "create_wordGroups", genomeWords,
+		[&]() { buckets = genomeBuckets; },
+		[&]() { buckets.create_wordGroups(); });
+
+	run_benchmark(params, "fswm_complete", params.queries,
+		[&]() { scoring = Scoring(); },
+		[&]() { Algorithms::fswm_complete(groupedGenomeBuckets, groupedQueryBuckets, scoring, parameters); });
+
+	run_benchmark(params, "calculate_fswm_distances", pairs,
+		[&]() { scoring = matched; },
+		[&]() { scoring.calculate_fswm_distances(parameters); });
+
+	std::vector<seq_id_t> leafIDs;
+	for (auto const &leaf : tree.leave_iterator) {
+		leafIDs.push_back(leaf->ID);
+	}
+	std::vector<std::vector<seq_id_t>> leafPairs;
+	std::mt19937 generator(params.seed);
+	std::uniform_int_distribution<size_t> leafDist(0, leafIDs.size() - 1);
+	for (int i = 0; i < params.lcaQueries; i++) {
+		leafPairs.push_back(std::vector<seq_id_t> {leafIDs[leafDist(generator)], leafIDs[leafDist(generator)]});
+	}
+	seq_id_t lcaChecksum = 0;
+	run_benchmark(params, "find_LCA", params.lcaQueries,
+		[&]() { lcaChecksum = 0; },
+		[&]() { for (auto const &leafPair : leafPairs) { lcaChecksum += tree.find_LCA(leafPair)->ID; } });
+
+	std::vector<PlacementRecord> placement {PlacementRecord {0, 0.01, 0.05, 1}};
+	std::vector<std::string> queryNames;
+	for (auto const &query : queries) {
+		queryNames.push_back(query.get_header());
+	}
+	std::unique_ptr<PlacementWriter> writer;
+	run_benchmark(params, "jplace_writer", params.queries,
+		[&]() { writer.reset(new PlacementWriter(jplacefname, "jplace")); },
+		[&]() {
+			tree.write_jplace_data_beginning(*writer);
+			for (size_t i = 0; i < queryNames.size(); i++) {
+				placement[0].edge = i % tree.dfs_iterator.size();
+				writer->write_placement(i, queryNames[i], placement, 1);
+			}
+			writer->write_end();
+		});
+	writer.reset();
+
+	unlink(queriesfname.c_str());
+	unlink(referencesfname.c_str());
+	unlink(treefname.c_str());
+	unlink(jplacefname.c_str());
+	rmdir(folder);
+
+	if (lcaChecksum == 1) {		// Keep find_LCA calls from being optimized away
+		std::cout << "#" << std::endl;
+	}
+	return EXIT_SUCCESS;
+}
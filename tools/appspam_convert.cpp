@@ -0,0 +1,69 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Converts binary output files of appspam to their text formats.
+ *
+ * Example:
+ * 	./appspam_convert placements.bplace placements.jplace
+ * 	./appspam_convert placements.bplace placements.jplace.gz
+ * 	./appspam_convert scoring.bscore outfolder/
+ */
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include "PlacementWriter.h"
+#include "ScoringWriter.h"
+
+static bool ends_with(const std::string &str, const std::string &suffix) {
+	return str.size() >= suffix.size() and str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc != 3) {
+		std::cout << "Convert binary output files of appspam to text formats." << std::endl << std::endl
+		          << "Usage:" << std::endl
+		          << "\t./appspam_convert <in.bplace> <out.jplace>       Binary placements to JPlace" << std::endl
+		          << "\t./appspam_convert <in.bplace> <out.jplace.gz>    Binary placements to gzip compressed JPlace" << std::endl
+		          << "\t./appspam_convert <in.bscore> <outfolder/>       Binary scores to scoring_table.txt and scoring_list.txt" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::string infname = argv[1];
+	std::string outfname = argv[2];
+
+	char magic[8] = {0};
+	std::ifstream in(infname, std::ios::binary);
+	in.read(magic, 8);
+	if (std::memcmp(magic, "APPSPAMS", 8) == 0) {
+		if (!outfname.empty() and outfname.back() != '/') {
+			outfname += "/";
+		}
+		return ScoringWriter::convert_to_text(infname, outfname) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	std::string format = ends_with(outfname, ".gz") ? "jplace.gz" : "jplace";
+	if (!PlacementWriter::format_supported(format)) {
+		std::cerr << "ERROR: Output format is not supported by this build: " << format << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (!PlacementWriter::convert_binary(infname, outfname, format)) {
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
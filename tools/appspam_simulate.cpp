@@ -0,0 +1,246 @@
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * author: Matthias Blanke
+ * mail  : matthias.blanke@biologie.uni-goettingen.de
+ */
+
+/**
+ * Creates synthetic references, reference tree and queries with known true placements,
+ * and evaluates JPlace files of appspam against the true placements.
+ *
+ * Example:
+ * 	./appspam_simulate --leaves 200 --length 20000 --queries 10000 -o sim
+ * 	./appspam -s sim_references.fasta -t sim_tree.nwk -q sim_queries.fasta -o sim.jplace
+ * 	./appspam_simulate --evaluate sim sim.jplace
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <getopt.h>
+#include "Simulator.h"
+
+static void print_usage() {
+	std::cout << R""""(
+Create synthetic data with:
+	./appspam_simulate [parameters] -o <prefix>
+
+Writes <prefix>_references.fasta, <prefix>_tree.nwk and <prefix>_queries.fasta,
+which can be given to appspam with -s, -t and -q, and the true placements
+<prefix>_truth.tsv and edges of the tree <prefix>_edges.tsv.
+
+    -o  --out               Prefix of output files (default sim).
+        --leaves            Number of references (default 100).
+        --length            Length of references (default 10000).
+        --queries           Number of queries (default 1000).
+        --query-length      Length of queries (default 150).
+        --branch-length     Mean branch length of the tree (default 0.05).
+        --pendant-length    Mean pendant length of queries (default 0.02).
+        --seed              Seed of random number generator (default 1).
+
+Evaluate placements with:
+	./appspam_simulate --evaluate <prefix> <placements.jplace>
+
+Prints the fraction of queries placed on the true edge, the mean number of
+edges between placed and true edge (first placement of every query) and a
+checksum of all placements that does not depend on the order of queries.
+)"""";
+}
+
+/**
+ * Read first placed edge of every query from a JPlace file written by appspam.
+ * All placements of every query are appended to records for the checksum.
+ */
+static std::unordered_map<std::string, uint32_t> read_jplace_edges(std::string filename, std::vector<std::string> &records) {
+	std::ifstream jplace(filename);
+	std::stringstream buffer;
+	buffer << jplace.rdbuf();
+	std::string text = buffer.str();
+
+	std::unordered_map<std::string, uint32_t> placedEdges;
+	size_t pos = text.find("\"placements\"");
+	while (pos != std::string::npos) {
+		size_t p = text.find("\"p\":", pos);
+		if (p == std::string::npos) {
+			break;
+		}
+		p = text.find("[[", p);
+		size_t nm = text.find("\"nm\":", p);
+		if (p == std::string::npos or nm == std::string::npos) {
+			break;
+		}
+		uint32_t edge = std::stoul(text.substr(p + 2, 12));
+		size_t nameStart = text.find("[[\"", nm) + 3;
+		size_t nameEnd = text.find("\"", nameStart);
+		placedEdges[text.substr(nameStart, nameEnd - nameStart)] = edge;
+		records.push_back(text.substr(nameStart, nameEnd - nameStart) + "\t" + text.substr(p, text.find("]]", p) + 2 - p));
+		pos = nameEnd;
+	}
+	return placedEdges;
+}
+
+/** Number of edges on the path between two edges, given the parent edge of every edge. */
+static int edge_distance(uint32_t a, uint32_t b, const std::unordered_map<uint32_t, int64_t> &parents) {
+	std::unordered_map<uint32_t, int> depthsA;
+	int depth = 0;
+	for (int64_t e = a; e >= 0; e = parents.at(e)) {
+		depthsA[e] = depth++;
+	}
+	depth = 0;
+	for (int64_t e = b; e >= 0; e = parents.at(e)) {
+		auto it = depthsA.find(e);
+		if (it != depthsA.end()) {
+			return it->second + depth;
+		}
+		depth++;
+	}
+	return -1;
+}
+
+static int evaluate(std::string prefix, std::string jplacefname) {
+	std::unordered_map<uint32_t, int64_t> parents;
+	std::ifstream edges(prefix + "_edges.tsv");
+	std::string line;
+	std::getline(edges, line);
+	while (std::getline(edges, line)) {
+		std::stringstream fields(line);
+		uint32_t edge;
+		int64_t parent;
+		fields >> edge >> parent;
+		parents[edge] = parent;
+	}
+
+	std::vector<std::string> records;
+	std::unordered_map<std::string, uint32_t> placedEdges = read_jplace_edges(jplacefname, records);
+	if (parents.empty() or placedEdges.empty()) {
+		std::cerr << "ERROR: Could not read edges of " << prefix << " or placements of " << jplacefname << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::ifstream truth(prefix + "_truth.tsv");
+	std::getline(truth, line);
+	uint64_t queries = 0, correct = 0, missing = 0, distanceSum = 0;
+	while (std::getline(truth, line)) {
+		std::stringstream fields(line);
+		std::string name;
+		uint32_t edge;
+		fields >> name >> edge;
+		queries++;
+
+		auto placed = placedEdges.find(name);
+		if (placed == placedEdges.end() or parents.find(placed->second) == parents.end()) {
+			missing++;
+			continue;
+		}
+		int distance = edge_distance(placed->second, edge, parents);
+		correct += distance == 0;
+		distanceSum += distance;
+	}
+
+	// FNV-1a hash of all placements sorted by query, independent of the order of queries in the file
+	std::sort(records.begin(), records.end());
+	uint64_t checksum = 14695981039346656037ULL;
+	for (auto const &record : records) {
+		for (char c : record + "\n") {
+			checksum = (checksum ^ (unsigned char) c) * 1099511628211ULL;
+		}
+	}
+
+	uint64_t placed = queries - missing;
+	std::cout << "queries\t" << queries << "\n"
+			  << "placed\t" << placed << "\n"
+			  << "correct_edge\t" << (placed > 0 ? (double) correct / placed : 0) << "\n"
+			  << "mean_edge_distance\t" << (placed > 0 ? (double) distanceSum / placed : 0) << "\n"
+			  << "placement_checksum\t" << std::hex << checksum << std::dec << std::endl;
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+	std::string prefix = "sim";
+	int leaves = 100;
+	int length = 10000;
+	int queryCount = 1000;
+	int queryLength = 150;
+	double branchLength = 0.05;
+	double pendantLength = 0.02;
+	unsigned seed = 1;
+	bool evaluateMode = false;
+
+	static struct option long_options[] = {
+		{ "out", required_argument, 			nullptr, 'o' },
+		{ "help", no_argument, 					nullptr, 'h' },
+		{ "leaves", required_argument, 			nullptr, 1   },
+		{ "length", required_argument, 			nullptr, 2   },
+		{ "queries", required_argument, 		nullptr, 3   },
+		{ "query-length", required_argument, 	nullptr, 4   },
+		{ "branch-length", required_argument, 	nullptr, 5   },
+		{ "pendant-length", required_argument, 	nullptr, 6   },
+		{ "seed", required_argument, 			nullptr, 7   },
+		{ "evaluate", no_argument, 				nullptr, 8   },
+		0
+	};
+
+	int option_param, index;
+	while ((option_param = getopt_long(argc, argv, "o:h", long_options, &index)) != -1) {
+		switch (option_param) {
+			case 'o': prefix = optarg; break;
+			case 1: leaves = atoi(optarg); break;
+			case 2: length = atoi(optarg); break;
+			case 3: queryCount = atoi(optarg); break;
+			case 4: queryLength = atoi(optarg); break;
+			case 5: branchLength = atof(optarg); break;
+			case 6: pendantLength = atof(optarg); break;
+			case 7: seed = atoi(optarg); break;
+			case 8: evaluateMode = true; break;
+			default:
+				print_usage();
+				exit (EXIT_SUCCESS);
+		}
+	}
+
+	if (evaluateMode) {
+		if (argc - optind != 2) {
+			print_usage();
+			return EXIT_FAILURE;
+		}
+		return evaluate(argv[optind], argv[optind + 1]);
+	}
+
+	if (leaves < 2 or length < 1 or queryLength < 1 or branchLength <= 0 or pendantLength <= 0) {
+		std::cerr << "ERROR: Use at least 2 leaves and positive lengths." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Simulator simulator(seed);
+	simulator.simulate_tree(leaves, branchLength);
+	simulator.evolve_sequences(length);
+	std::vector<SimulatedQuery> queries = simulator.simulate_queries(queryCount, queryLength, pendantLength);
+
+	simulator.write_references(prefix + "_references.fasta");
+	simulator.write_tree(prefix + "_tree.nwk");
+	simulator.write_edges(prefix + "_edges.tsv");
+
+	std::ofstream queriesFile(prefix + "_queries.fasta");
+	std::ofstream truthFile(prefix + "_truth.tsv");
+	truthFile << "query\tedge\tdistal_length\tpendant_length\n";
+	for (auto const &query : queries) {
+		queriesFile << ">" << query.name << "\n" << query.seq << "\n";
+		truthFile << query.name << "\t" << query.edge << "\t" << query.distal_length << "\t" << query.pendant_length << "\n";
+	}
+
+	std::cout << "Wrote " << leaves << " references, tree and " << queries.size() << " queries with prefix " << prefix << std::endl;
+	return EXIT_SUCCESS;
+}